@@ -8,6 +8,9 @@ namespace cfg {
     // Rendering
     constexpr float POINT_SIZE       = 45.0f;
     constexpr float THRESHOLD        = 0.35f;
+    constexpr float INTERIOR_CELL    = 10.0f;     // coarse interior-layer texel size in pixels
+    constexpr float SURFACE_CELL     = 8.0f;      // surface-extraction node spacing in pixels
+    constexpr float SURFACE_EPSILON  = 0.25f;     // px a particle moves before its nodes are re-sampled
 
     // SPH
     constexpr float SMOOTHING_RADIUS = 16.0f;
@@ -20,8 +23,19 @@ namespace cfg {
     constexpr float BOUND_DAMPING    = -0.5f;
     constexpr float BOUND_PAD        = POINT_SIZE * 0.55f; // keep particle splats inside walls
     constexpr float WALL_THICKNESS   = 6.0f;      // visual wall width in pixels
+    constexpr float FIELD_CELL       = 32.0f;     // force-field grid spacing in pixels
+    constexpr int   REST_DENSITY_SAMPLES = 4096;  // particles averaged for rest density at reset
+
+    // Adaptive resolution — a level-L particle carries 2^L base masses and a
+    // smoothing radius scaled by sqrt(2)^L, so its neighbour count stays the same
+    constexpr int   MAX_LEVEL         = 2;
+    constexpr float SURFACE_GRADIENT  = 0.6f;     // colour-field |grad| * h above this = free surface
+    constexpr float MERGE_DEPTH       = 2.0f;     // merge below this many radii from the surface
+    constexpr float SPLIT_DEPTH       = 1.0f;     // split above this many radii from the surface
+    constexpr float SPLIT_SHEAR       = 8.0f;     // 1/s — split regardless of depth above this
 
     // Mouse interaction
     constexpr float MOUSE_RADIUS     = 100.0f;
     constexpr float MOUSE_STRENGTH   = 8000.0f;
+    constexpr float PAN_SPEED        = 15.0f;     // px per frame while an arrow key is held
 }
@@ -0,0 +1,256 @@
+#include "cpu_renderer.h"
+#include "simulation.h"
+#include "config.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CPU_RENDERER_SSE2 1
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static float elapsedMs(Clock::time_point since) {
+    return std::chrono::duration<float, std::milli>(Clock::now() - since).count();
+}
+
+// dst[k] += w[k] * wy — the inner loop of the splat pass
+static inline void accumulateRow(float* dst, const float* w, float wy, int n) {
+    int k = 0;
+#ifdef CPU_RENDERER_SSE2
+    __m128 s = _mm_set1_ps(wy);
+    for (; k + 4 <= n; k += 4) {
+        __m128 d = _mm_loadu_ps(dst + k);
+        _mm_storeu_ps(dst + k, _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(w + k), s)));
+    }
+#endif
+    for (; k < n; k++) dst[k] += w[k] * wy;
+}
+
+// w[k] = exp(-18 c_k^2) and c2[k] = c_k^2 for c_k = c0 + k * step. The
+// exponentials follow from the recurrence w[k+1] = w[k] * q[k],
+// q[k+1] = q[k] * exp(-36 step^2), so a whole row costs three expf calls.
+static inline void gaussianRow(float c0, float step, int n, float* w, float* c2) {
+    float g = expf(-18.0f * c0 * c0);
+    float q = expf(-18.0f * step * (2.0f * c0 + step));
+    const float qq = expf(-36.0f * step * step);
+    for (int k = 0; k < n; k++) {
+        float c = c0 + (float)k * step;
+        c2[k] = c * c;
+        w[k]  = g;
+        g *= q;
+        q *= qq;
+    }
+}
+
+static inline float smoothstep(float e0, float e1, float x) {
+    float t = std::min(std::max((x - e0) / (e1 - e0), 0.0f), 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+static inline unsigned char toByte(float c) {
+    c = std::min(std::max(c, 0.0f), 1.0f);
+    return (unsigned char)(c * 255.0f + 0.5f);
+}
+
+// Pixel range [lo, hi] whose centres lie within `radius` of `c`
+static inline void pixelSpan(float c, float radius, int limit, int& lo, int& hi) {
+    lo = std::max((int)ceilf(c - radius - 0.5f), 0);
+    hi = std::min((int)floorf(c + radius - 0.5f), limit - 1);
+}
+
+CpuRenderer::CpuRenderer(int w, int h, int threadCount)
+    : width(w), height(h), pool(threadCount)
+{
+    tilesX = (width  + TILE - 1) / TILE;
+    tilesY = (height + TILE - 1) / TILE;
+    density.assign((size_t)width * height, 0.0f);
+    rgb.assign((size_t)width * height * 3, 0);
+    binStart.assign(tilesX * tilesY + 1, 0);
+}
+
+template <class F>
+void CpuRenderer::forEachTile(F&& f) {
+    pool.forEach(tilesX * tilesY, f);
+}
+
+// Counting sort of particles into the tiles their splat overlaps
+void CpuRenderer::binParticles(const SPHSimulation& sim) {
+    const float radius = cfg::POINT_SIZE * 0.5f;
+    const int tiles = tilesX * tilesY;
+
+    std::fill(binStart.begin(), binStart.end(), 0);
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < sim.count; i++) {
+            int x0, x1, y0, y1;
+            pixelSpan(sim.posX[i] - viewX, radius, width,  x0, x1);
+            pixelSpan(sim.posY[i] - viewY, radius, height, y0, y1);
+            if (x0 > x1 || y0 > y1) continue;
+
+            for (int ty = y0 / TILE; ty <= y1 / TILE; ty++) {
+                for (int tx = x0 / TILE; tx <= x1 / TILE; tx++) {
+                    int t = ty * tilesX + tx;
+                    if (pass == 0) binStart[t + 1]++;
+                    else           binItems[binStart[t]++] = i;
+                }
+            }
+        }
+
+        if (pass == 0) {
+            for (int t = 0; t < tiles; t++) binStart[t + 1] += binStart[t];
+            binItems.resize(binStart[tiles]);
+        } else {
+            // The fill advanced every start to the next tile's; shift back
+            for (int t = tiles; t > 0; t--) binStart[t] = binStart[t - 1];
+            binStart[0] = 0;
+        }
+    }
+}
+
+// Splat pass: exp(-r2 * 18) over the unit point sprite, discarded past
+// r2 = 0.25, as in SPLAT_FS. The Gaussian factors into a per-column and a
+// per-row weight, and the r2 cut-off leaves one contiguous span per row.
+void CpuRenderer::splatTile(int tile, const SPHSimulation& sim) {
+    const float size   = cfg::POINT_SIZE;
+    const float radius = size * 0.5f;
+    const int tx0 = (tile % tilesX) * TILE, tx1 = std::min(tx0 + TILE, width)  - 1;
+    const int ty0 = (tile / tilesX) * TILE, ty1 = std::min(ty0 + TILE, height) - 1;
+
+    for (int y = ty0; y <= ty1; y++)
+        std::fill(&density[(size_t)y * width + tx0], &density[(size_t)y * width + tx1] + 1, 0.0f);
+
+    float wx[TILE], cx2[TILE], wy[TILE], cy2s[TILE];
+    for (int b = binStart[tile]; b < binStart[tile + 1]; b++) {
+        int i = binItems[b];
+        float px = sim.posX[i] - viewX, py = sim.posY[i] - viewY;
+
+        int x0, x1, y0, y1;
+        pixelSpan(px, radius, width,  x0, x1);
+        pixelSpan(py, radius, height, y0, y1);
+        x0 = std::max(x0, tx0); x1 = std::min(x1, tx1);
+        y0 = std::max(y0, ty0); y1 = std::min(y1, ty1);
+        if (x0 > x1 || y0 > y1) continue;
+
+        int n = x1 - x0 + 1;
+        gaussianRow(((float)x0 + 0.5f - px) / size, 1.0f / size, n, wx, cx2);
+        gaussianRow(((float)y0 + 0.5f - py) / size, 1.0f / size, y1 - y0 + 1, wy, cy2s);
+
+        for (int y = y0; y <= y1; y++) {
+            float cy2 = cy2s[y - y0];
+            if (cy2 > 0.25f) continue;
+
+            // Chord of the r2 = 0.25 circle on this row, nudged onto the
+            // exact per-pixel test
+            float half = sqrtf(0.25f - cy2) * size;
+            int lo = std::max((int)ceilf(px - half - 0.5f) - x0, 0);
+            int hi = std::min((int)floorf(px + half - 0.5f) - x0, n - 1);
+            while (lo > 0     && cx2[lo - 1] + cy2 <= 0.25f) lo--;
+            while (lo <= hi   && cx2[lo]     + cy2 >  0.25f) lo++;
+            while (hi < n - 1 && cx2[hi + 1] + cy2 <= 0.25f) hi++;
+            while (hi >= lo   && cx2[hi]     + cy2 >  0.25f) hi--;
+            if (lo > hi) continue;
+
+            accumulateRow(&density[(size_t)y * width + x0 + lo], wx + lo, wy[y - y0], hi - lo + 1);
+        }
+    }
+}
+
+// Background and fluid passes: BG_FS, then FLUID_FS blended over it
+void CpuRenderer::shadeTile(int tile, const SPHSimulation& sim) {
+    const float thresh = cfg::THRESHOLD;
+    const float wall   = cfg::WALL_THICKNESS;
+    const Scenario::Block& walls = sim.bounds;
+    const int tx0 = (tile % tilesX) * TILE, tx1 = std::min(tx0 + TILE, width)  - 1;
+    const int ty0 = (tile / tilesX) * TILE, ty1 = std::min(ty0 + TILE, height) - 1;
+
+    // normalize(vec3(0.4, -0.5, 0.8))
+    const float lInv = 1.0f / sqrtf(0.4f * 0.4f + 0.5f * 0.5f + 0.8f * 0.8f);
+    const float lx = 0.4f * lInv, ly = -0.5f * lInv, lz = 0.8f * lInv;
+
+    for (int y = ty0; y <= ty1; y++) {
+        // GL's origin is bottom-left; row 0 here is the top of the image
+        float fragY = (float)(height - y) - 0.5f;
+        float v = fragY / (float)height;
+        float simY = (float)y + 0.5f + viewY;
+        const float* row = &density[(size_t)y * width];
+        const float* up  = &density[(size_t)std::max(y - 1, 0) * width];
+        const float* dn  = &density[(size_t)std::min(y + 1, height - 1) * width];
+
+        for (int x = tx0; x <= tx1; x++) {
+            float fragX = (float)x + 0.5f;
+            float r = 0.07f + (0.03f - 0.07f) * v;
+            float g = r;
+            float b = 0.11f + (0.06f - 0.11f) * v;
+            float simX = fragX + viewX;
+            if (simX < walls.x0 + wall || simX > walls.x1 - wall ||
+                simY < walls.y0 + wall || simY > walls.y1 - wall) {
+                r = 0.30f; g = 0.36f; b = 0.48f;
+            }
+
+            float d = row[x];
+            if (d >= thresh) {
+                float dL = row[std::max(x - 1, 0)];
+                float dR = row[std::min(x + 1, width - 1)];
+                float dD = dn[x];
+                float dU = up[x];
+                float nx = dL - dR, ny = dD - dU, nz = 0.18f;
+                float nInv = 1.0f / sqrtf(nx * nx + ny * ny + nz * nz);
+                nx *= nInv; ny *= nInv; nz *= nInv;
+
+                float nl   = nx * lx + ny * ly + nz * lz;
+                float diff = std::max(nl, 0.0f);
+                float rz   = 2.0f * nl * nz - lz;   // reflect(-l, n).z
+                float s2   = std::max(rz, 0.0f);        // pow(.., 48) by squaring
+                s2 *= s2;
+                float s16  = s2 * s2;
+                s16 *= s16;
+                s16 *= s16;
+                float spec = s16 * s16 * s16;
+
+                float depth = smoothstep(thresh, thresh + 2.0f, d);
+                float wr = 0.15f + (0.02f - 0.15f) * depth;
+                float wg = 0.50f + (0.10f - 0.50f) * depth;
+                float wb = 0.90f + (0.32f - 0.90f) * depth;
+
+                float lit = 0.35f + 0.55f * diff;
+                float s   = spec * 0.7f;
+                float a   = smoothstep(thresh, thresh + 0.12f, d) * 0.93f;
+                r += ((wr * lit + 0.85f * s) - r) * a;
+                g += ((wg * lit + 0.92f * s) - g) * a;
+                b += ((wb * lit + 1.00f * s) - b) * a;
+            }
+
+            unsigned char* out = &rgb[((size_t)y * width + x) * 3];
+            out[0] = toByte(r);
+            out[1] = toByte(g);
+            out[2] = toByte(b);
+        }
+    }
+}
+
+void CpuRenderer::render(const SPHSimulation& sim) {
+    Clock::time_point t = Clock::now();
+    binParticles(sim);
+    forEachTile([&](int tile) { splatTile(tile, sim); });
+    splatMs = elapsedMs(t);
+
+    t = Clock::now();
+    forEachTile([&](int tile) { shadeTile(tile, sim); });
+    compositeMs = elapsedMs(t);
+}
+
+bool CpuRenderer::writePPM(const char* path) const {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Cannot write frame: %s\n", path);
+        return false;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    bool ok = fwrite(rgb.data(), 1, rgb.size(), f) == rgb.size();
+    fclose(f);
+    if (!ok) fprintf(stderr, "Short write: %s\n", path);
+    return ok;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "worker_pool.h"
+#include <vector>
+
+class SPHSimulation;   // forward decl
+
+// Software version of FluidRenderer for machines without a GPU. It runs the
+// same two passes — Gaussian splats into a density buffer, then the
+// threshold / gradient-normal / shading step of FLUID_FS over the BG_FS
+// background — and produces an 8-bit RGB image, top row first.
+//
+// The image is cut into tiles. Particles are binned to every tile their
+// splat touches, then worker threads take whole tiles, so no two threads
+// ever write the same pixel. The threads are started once, with the
+// renderer, and reused by both passes of every frame.
+class CpuRenderer {
+public:
+    CpuRenderer(int width, int height, int threads = 0);   // 0 = one per core
+
+    void render(const SPHSimulation& sim);
+    bool writePPM(const char* path) const;
+
+    const std::vector<unsigned char>& image() const { return rgb; }
+    const std::vector<float>&         densityBuffer() const { return density; }
+
+    // Simulation coordinates at the image's top-left corner, as in FluidRenderer
+    float viewX = 0.0f, viewY = 0.0f;
+
+    // Wall-clock time of each pass in ms for the last render()
+    float splatMs     = 0.0f;
+    float compositeMs = 0.0f;
+
+private:
+    static constexpr int TILE = 128;
+
+    int width, height;
+    int tilesX, tilesY;
+    WorkerPool pool;
+
+    std::vector<float>         density;    // splat accumulation, one float per pixel
+    std::vector<unsigned char> rgb;
+
+    // Particles per tile, stored compactly: tile t owns
+    // binItems[binStart[t] .. binStart[t + 1])
+    std::vector<int> binStart;
+    std::vector<int> binItems;
+
+    void binParticles(const SPHSimulation& sim);
+    void splatTile(int tile, const SPHSimulation& sim);
+    void shadeTile(int tile, const SPHSimulation& sim);
+    template <class F> void forEachTile(F&& f);
+};
@@ -0,0 +1,98 @@
+#include "force_field.h"
+#include <algorithm>
+#include <cmath>
+
+static constexpr float PI = 3.14159265358979323846f;
+
+// Enough for a 32 px grid over 32,000 x 32,000 px; a source reaching past
+// that gets a coarser grid rather than an unbounded one
+static constexpr long MAX_NODES = 1 << 20;
+
+void ForceField::fit(float x0, float y0, float x1, float y1, float cellSize) {
+    // Union of the radial sources' reach, clipped to the walls
+    float bx0 = INFINITY, by0 = INFINITY, bx1 = -INFINITY, by1 = -INFINITY;
+    for (const FieldSource& s : sources) {
+        if (s.kind == FieldSource::Wind) continue;
+        float sx0 = std::max(s.x - s.radius, x0), sx1 = std::min(s.x + s.radius, x1);
+        float sy0 = std::max(s.y - s.radius, y0), sy1 = std::min(s.y + s.radius, y1);
+        if (!(sx0 < sx1 && sy0 < sy1)) continue;   // entirely beyond a wall
+        bx0 = std::min(bx0, sx0);
+        by0 = std::min(by0, sy0);
+        bx1 = std::max(bx1, sx1);
+        by1 = std::max(by1, sy1);
+    }
+    if (!(bx0 < bx1 && by0 < by1)) bx0 = by0 = 0.0f, bx1 = by1 = cellSize;   // nothing to bake
+
+    // Nodes on the cell lattice, one past each end so every sample inside
+    // the area has four neighbours
+    for (cell = cellSize;; cell *= 2.0f) {
+        originX = (floorf(bx0 / cell) - 1.0f) * cell;
+        originY = (floorf(by0 / cell) - 1.0f) * cell;
+        nx = (int)ceilf((bx1 - originX) / cell) + 2;
+        ny = (int)ceilf((by1 - originY) / cell) + 2;
+        if ((long)nx * ny <= MAX_NODES) break;
+    }
+    invCell = 1.0f / cell;
+    accX.assign((size_t)nx * ny, 0.0f);
+    accY.assign((size_t)nx * ny, 0.0f);
+}
+
+bool ForceField::footprint(const FieldSource& s, int& x0, int& y0, int& x1, int& y1) const {
+    float fx0 = ceilf((s.x - s.radius - originX) * invCell);
+    float fy0 = ceilf((s.y - s.radius - originY) * invCell);
+    float fx1 = floorf((s.x + s.radius - originX) * invCell);
+    float fy1 = floorf((s.y + s.radius - originY) * invCell);
+    if (!(fx0 <= (float)(nx - 1) && fy0 <= (float)(ny - 1) && fx1 >= 0.0f && fy1 >= 0.0f)) return false;
+    x0 = (int)std::max(fx0, 0.0f);
+    y0 = (int)std::max(fy0, 0.0f);
+    x1 = (int)std::min(fx1, (float)(nx - 1));
+    y1 = (int)std::min(fy1, (float)(ny - 1));
+    return x0 <= x1 && y0 <= y1;
+}
+
+// Every node a radial source has written is inside its footprint, so
+// clearing the footprints clears everything the last bake left
+void ForceField::bake(float time) {
+    windX = windY = 0.0f;
+    for (const FieldSource& s : sources) {
+        int x0, y0, x1, y1;
+        if (s.kind == FieldSource::Wind || !footprint(s, x0, y0, x1, y1)) continue;
+        for (int iy = y0; iy <= y1; iy++) {
+            std::fill(accX.begin() + iy * nx + x0, accX.begin() + iy * nx + x1 + 1, 0.0f);
+            std::fill(accY.begin() + iy * nx + x0, accY.begin() + iy * nx + x1 + 1, 0.0f);
+        }
+    }
+
+    for (const FieldSource& s : sources) {
+        float scale = s.period > 0.0f ? sinf(2.0f * PI * time / s.period) : 1.0f;
+
+        if (s.kind == FieldSource::Wind) {
+            windX += s.x * scale;
+            windY += s.y * scale;
+            continue;
+        }
+
+        int x0, y0, x1, y1;
+        if (!footprint(s, x0, y0, x1, y1)) continue;
+        for (int iy = y0; iy <= y1; iy++) {
+            for (int ix = x0; ix <= x1; ix++) {
+                float dx = originX + (float)ix * cell - s.x;
+                float dy = originY + (float)iy * cell - s.y;
+                float d2 = dx * dx + dy * dy;
+                if (d2 >= s.radius * s.radius || d2 < 1e-6f) continue;
+
+                float d = sqrtf(d2);
+                float f = s.strength * scale * (1.0f - d / s.radius) / d;
+                int   n = iy * nx + ix;
+                if (s.kind == FieldSource::Vortex) {
+                    // Tangent (-dy, dx) turns clockwise with y pointing down
+                    accX[n] += -dy * f;
+                    accY[n] +=  dx * f;
+                } else {
+                    accX[n] -= dx * f;
+                    accY[n] -= dy * f;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+// One external forcing effect. Strengths are accelerations in px/s².
+struct FieldSource {
+    enum Kind { Wind, Vortex, Attractor };
+    Kind  kind;
+    float x, y;          // Wind: acceleration vector. Others: centre
+    float strength;      // Vortex: + spins clockwise on screen. Attractor: + pulls in
+    float radius;        // falloff radius; strength fades linearly to zero at it
+    float period;        // seconds; > 0 oscillates the strength between + and -
+};
+
+// External forces baked onto a coarse grid. Every source is summed into the
+// grid once per frame, and particles read it back with a single bilinear
+// sample, so the per-particle cost does not grow with the number of sources.
+// Vortices and attractors only touch the nodes inside their radius, and the
+// winds sum to one uniform term added at sampling, so a bake costs the
+// sources' footprints rather than the whole grid. The grid itself only
+// spans those footprints, clipped to the walls, so it is anchored wherever
+// the sources are and stays finite on an open domain; outside it only the
+// wind acts.
+class ForceField {
+public:
+    std::vector<FieldSource> sources;
+
+    // Size and place the grid around the radial `sources`, clipped to the
+    // rectangle (x0, y0)-(x1, y1); infinite sides are open. Call again if
+    // the sources change.
+    void fit(float x0, float y0, float x1, float y1, float cellSize);
+    void bake(float time);
+    bool empty() const { return sources.empty(); }
+
+    // Bilinear sample of the baked acceleration at (x, y)
+    void sample(float x, float y, float& outX, float& outY) const {
+        outX = windX;
+        outY = windY;
+        float gx = (x - originX) * invCell;
+        float gy = (y - originY) * invCell;
+        if (!(gx >= 0.0f && gy >= 0.0f && gx <= (float)(nx - 1) && gy <= (float)(ny - 1))) return;
+        int   ix = (int)gx;
+        int   iy = (int)gy;
+        ix = ix > nx - 2 ? nx - 2 : ix;
+        iy = iy > ny - 2 ? ny - 2 : iy;
+        float tx = gx - (float)ix;
+        float ty = gy - (float)iy;
+
+        int n = iy * nx + ix;
+        float w00 = (1.0f - tx) * (1.0f - ty), w10 = tx * (1.0f - ty);
+        float w01 = (1.0f - tx) * ty,          w11 = tx * ty;
+        outX += w00 * accX[n] + w10 * accX[n + 1] + w01 * accX[n + nx] + w11 * accX[n + nx + 1];
+        outY += w00 * accY[n] + w10 * accY[n + 1] + w01 * accY[n + nx] + w11 * accY[n + nx + 1];
+    }
+
+private:
+    int   nx = 2, ny = 2;          // grid nodes per axis
+    float originX = 0.0f, originY = 0.0f;   // position of node (0, 0)
+    float cell = 1.0f, invCell = 1.0f;
+    std::vector<float> accX, accY; // acceleration at each node, radial sources only
+    float windX = 0.0f, windY = 0.0f;
+
+    // Nodes a radial source can reach, clipped to the grid
+    bool footprint(const FieldSource& s, int& x0, int& y0, int& x1, int& y1) const;
+};
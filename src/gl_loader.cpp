@@ -25,12 +25,15 @@ PFNGLGETUNIFORMLOCATIONPROC       glGetUniformLocation       = nullptr;
 PFNGLUNIFORM1IPROC               glUniform1i               = nullptr;
 PFNGLUNIFORM1FPROC               glUniform1f               = nullptr;
 PFNGLUNIFORM2FPROC               glUniform2f               = nullptr;
+PFNGLUNIFORM4FPROC               glUniform4f               = nullptr;
 
 PFNGLGENBUFFERSPROC               glGenBuffers               = nullptr;
 PFNGLDELETEBUFFERSPROC            glDeleteBuffers            = nullptr;
 PFNGLBINDBUFFERPROC               glBindBuffer               = nullptr;
 PFNGLBUFFERDATAPROC               glBufferData               = nullptr;
 PFNGLBUFFERSUBDATAPROC            glBufferSubData            = nullptr;
+PFNGLMAPBUFFERRANGEPROC           glMapBufferRange           = nullptr;
+PFNGLUNMAPBUFFERPROC              glUnmapBuffer              = nullptr;
 
 PFNGLENABLEVERTEXATTRIBARRAYPROC  glEnableVertexAttribArray  = nullptr;
 PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray = nullptr;
@@ -46,12 +49,29 @@ PFNGLBINDFRAMEBUFFERPROC          glBindFramebuffer          = nullptr;
 PFNGLFRAMEBUFFERTEXTURE2DPROC     glFramebufferTexture2D     = nullptr;
 PFNGLCHECKFRAMEBUFFERSTATUSPROC   glCheckFramebufferStatus   = nullptr;
 
+PFNGLGENQUERIESPROC               glGenQueries               = nullptr;
+PFNGLDELETEQUERIESPROC            glDeleteQueries            = nullptr;
+PFNGLBEGINQUERYPROC               glBeginQuery               = nullptr;
+PFNGLENDQUERYPROC                 glEndQuery                 = nullptr;
+PFNGLGETQUERYOBJECTIVPROC         glGetQueryObjectiv         = nullptr;
+PFNGLGETQUERYOBJECTUI64VPROC      glGetQueryObjectui64v      = nullptr;
+
+PFNGLFENCESYNCPROC                glFenceSync                = nullptr;
+PFNGLCLIENTWAITSYNCPROC           glClientWaitSync           = nullptr;
+PFNGLDELETESYNCPROC               glDeleteSync               = nullptr;
+
+PFNGLBUFFERSTORAGEPROC            glBufferStorage            = nullptr;
+
 // ---- Loader ----
 
 #define LOAD(type, name) \
     name = (type)glfwGetProcAddress(#name); \
     if (!name) { fprintf(stderr, "Failed to load: %s\n", #name); ok = false; }
 
+// Extension entry points: only trusted when the driver advertises them
+#define LOAD_OPTIONAL(type, name, extension) \
+    name = glfwExtensionSupported(extension) ? (type)glfwGetProcAddress(#name) : nullptr;
+
 bool loadGL() {
     bool ok = true;
 
@@ -77,12 +97,15 @@ bool loadGL() {
     LOAD(PFNGLUNIFORM1IPROC,               glUniform1i);
     LOAD(PFNGLUNIFORM1FPROC,               glUniform1f);
     LOAD(PFNGLUNIFORM2FPROC,               glUniform2f);
+    LOAD(PFNGLUNIFORM4FPROC,               glUniform4f);
 
     LOAD(PFNGLGENBUFFERSPROC,               glGenBuffers);
     LOAD(PFNGLDELETEBUFFERSPROC,            glDeleteBuffers);
     LOAD(PFNGLBINDBUFFERPROC,               glBindBuffer);
     LOAD(PFNGLBUFFERDATAPROC,               glBufferData);
     LOAD(PFNGLBUFFERSUBDATAPROC,            glBufferSubData);
+    LOAD(PFNGLMAPBUFFERRANGEPROC,           glMapBufferRange);
+    LOAD(PFNGLUNMAPBUFFERPROC,              glUnmapBuffer);
 
     LOAD(PFNGLENABLEVERTEXATTRIBARRAYPROC,  glEnableVertexAttribArray);
     LOAD(PFNGLDISABLEVERTEXATTRIBARRAYPROC, glDisableVertexAttribArray);
@@ -98,7 +121,21 @@ bool loadGL() {
     LOAD(PFNGLFRAMEBUFFERTEXTURE2DPROC,     glFramebufferTexture2D);
     LOAD(PFNGLCHECKFRAMEBUFFERSTATUSPROC,   glCheckFramebufferStatus);
 
+    LOAD(PFNGLGENQUERIESPROC,               glGenQueries);
+    LOAD(PFNGLDELETEQUERIESPROC,            glDeleteQueries);
+    LOAD(PFNGLBEGINQUERYPROC,               glBeginQuery);
+    LOAD(PFNGLENDQUERYPROC,                 glEndQuery);
+    LOAD(PFNGLGETQUERYOBJECTIVPROC,         glGetQueryObjectiv);
+    LOAD(PFNGLGETQUERYOBJECTUI64VPROC,      glGetQueryObjectui64v);
+
+    LOAD(PFNGLFENCESYNCPROC,                glFenceSync);
+    LOAD(PFNGLCLIENTWAITSYNCPROC,           glClientWaitSync);
+    LOAD(PFNGLDELETESYNCPROC,               glDeleteSync);
+
+    LOAD_OPTIONAL(PFNGLBUFFERSTORAGEPROC,   glBufferStorage, "GL_ARB_buffer_storage");
+
     return ok;
 }
 
 #undef LOAD
+#undef LOAD_OPTIONAL
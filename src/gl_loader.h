@@ -4,11 +4,14 @@
 // We only need to add GL 2.0+ types, constants, and function pointers.
 #include <GLFW/glfw3.h>
 #include <cstddef>
+#include <cstdint>
 
 // ---- Types not in the GL 1.1 header ----
 typedef char      GLchar;
 typedef ptrdiff_t GLsizeiptr;
 typedef ptrdiff_t GLintptr;
+typedef uint64_t  GLuint64;
+typedef struct __GLsync* GLsync;
 
 // ---- Constants not in the GL 1.1 header ----
 #ifndef GL_FRAGMENT_SHADER
@@ -50,12 +53,48 @@ typedef ptrdiff_t GLintptr;
 #ifndef GL_RGBA16F
 #define GL_RGBA16F                0x881A
 #endif
+#ifndef GL_R16F
+#define GL_R16F                   0x822D
+#endif
 #ifndef GL_CLAMP_TO_EDGE
 #define GL_CLAMP_TO_EDGE          0x812F
 #endif
 #ifndef GL_PROGRAM_POINT_SIZE
 #define GL_PROGRAM_POINT_SIZE     0x8642
 #endif
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED           0x88BF
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT           0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW            0x88E0
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT          0x0002
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT     0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT       0x0080
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED        0x911B
+#endif
+#ifndef GL_WAIT_FAILED
+#define GL_WAIT_FAILED            0x911D
+#endif
 
 // ---- Function pointer types (APIENTRY = __stdcall on Windows) ----
 
@@ -85,6 +124,7 @@ typedef GLint    (APIENTRY *PFNGLGETUNIFORMLOCATIONPROC)(GLuint program, const G
 typedef void     (APIENTRY *PFNGLUNIFORM1IPROC)(GLint location, GLint v0);
 typedef void     (APIENTRY *PFNGLUNIFORM1FPROC)(GLint location, GLfloat v0);
 typedef void     (APIENTRY *PFNGLUNIFORM2FPROC)(GLint location, GLfloat v0, GLfloat v1);
+typedef void     (APIENTRY *PFNGLUNIFORM4FPROC)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
 
 // GL 2.0 — Buffers
 typedef void     (APIENTRY *PFNGLGENBUFFERSPROC)(GLsizei n, GLuint *buffers);
@@ -93,6 +133,10 @@ typedef void     (APIENTRY *PFNGLBINDBUFFERPROC)(GLenum target, GLuint buffer);
 typedef void     (APIENTRY *PFNGLBUFFERDATAPROC)(GLenum target, GLsizeiptr size, const void *data, GLenum usage);
 typedef void     (APIENTRY *PFNGLBUFFERSUBDATAPROC)(GLenum target, GLintptr offset, GLsizeiptr size, const void *data);
 
+// GL 3.0 — Buffer mapping
+typedef void*    (APIENTRY *PFNGLMAPBUFFERRANGEPROC)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean (APIENTRY *PFNGLUNMAPBUFFERPROC)(GLenum target);
+
 // GL 2.0 — Vertex attribs
 typedef void     (APIENTRY *PFNGLENABLEVERTEXATTRIBARRAYPROC)(GLuint index);
 typedef void     (APIENTRY *PFNGLDISABLEVERTEXATTRIBARRAYPROC)(GLuint index);
@@ -110,6 +154,22 @@ typedef void     (APIENTRY *PFNGLBINDFRAMEBUFFERPROC)(GLenum target, GLuint fram
 typedef void     (APIENTRY *PFNGLFRAMEBUFFERTEXTURE2DPROC)(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
 typedef GLenum   (APIENTRY *PFNGLCHECKFRAMEBUFFERSTATUSPROC)(GLenum target);
 
+// GL 3.3 — Timer queries
+typedef void     (APIENTRY *PFNGLGENQUERIESPROC)(GLsizei n, GLuint *ids);
+typedef void     (APIENTRY *PFNGLDELETEQUERIESPROC)(GLsizei n, const GLuint *ids);
+typedef void     (APIENTRY *PFNGLBEGINQUERYPROC)(GLenum target, GLuint id);
+typedef void     (APIENTRY *PFNGLENDQUERYPROC)(GLenum target);
+typedef void     (APIENTRY *PFNGLGETQUERYOBJECTIVPROC)(GLuint id, GLenum pname, GLint *params);
+typedef void     (APIENTRY *PFNGLGETQUERYOBJECTUI64VPROC)(GLuint id, GLenum pname, GLuint64 *params);
+
+// GL 3.2 — Sync objects
+typedef GLsync   (APIENTRY *PFNGLFENCESYNCPROC)(GLenum condition, GLbitfield flags);
+typedef GLenum   (APIENTRY *PFNGLCLIENTWAITSYNCPROC)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+typedef void     (APIENTRY *PFNGLDELETESYNCPROC)(GLsync sync);
+
+// GL 4.4 / ARB_buffer_storage — optional, null if the driver lacks it
+typedef void     (APIENTRY *PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
 // ---- Extern function pointer declarations ----
 
 extern PFNGLACTIVETEXTUREPROC            glActiveTexture;
@@ -134,12 +194,15 @@ extern PFNGLGETUNIFORMLOCATIONPROC       glGetUniformLocation;
 extern PFNGLUNIFORM1IPROC               glUniform1i;
 extern PFNGLUNIFORM1FPROC               glUniform1f;
 extern PFNGLUNIFORM2FPROC               glUniform2f;
+extern PFNGLUNIFORM4FPROC               glUniform4f;
 
 extern PFNGLGENBUFFERSPROC               glGenBuffers;
 extern PFNGLDELETEBUFFERSPROC            glDeleteBuffers;
 extern PFNGLBINDBUFFERPROC               glBindBuffer;
 extern PFNGLBUFFERDATAPROC               glBufferData;
 extern PFNGLBUFFERSUBDATAPROC            glBufferSubData;
+extern PFNGLMAPBUFFERRANGEPROC           glMapBufferRange;
+extern PFNGLUNMAPBUFFERPROC              glUnmapBuffer;
 
 extern PFNGLENABLEVERTEXATTRIBARRAYPROC  glEnableVertexAttribArray;
 extern PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray;
@@ -155,6 +218,20 @@ extern PFNGLBINDFRAMEBUFFERPROC          glBindFramebuffer;
 extern PFNGLFRAMEBUFFERTEXTURE2DPROC     glFramebufferTexture2D;
 extern PFNGLCHECKFRAMEBUFFERSTATUSPROC   glCheckFramebufferStatus;
 
+extern PFNGLGENQUERIESPROC               glGenQueries;
+extern PFNGLDELETEQUERIESPROC            glDeleteQueries;
+extern PFNGLBEGINQUERYPROC               glBeginQuery;
+extern PFNGLENDQUERYPROC                 glEndQuery;
+extern PFNGLGETQUERYOBJECTIVPROC         glGetQueryObjectiv;
+extern PFNGLGETQUERYOBJECTUI64VPROC      glGetQueryObjectui64v;
+
+extern PFNGLFENCESYNCPROC                glFenceSync;
+extern PFNGLCLIENTWAITSYNCPROC           glClientWaitSync;
+extern PFNGLDELETESYNCPROC               glDeleteSync;
+
+extern PFNGLBUFFERSTORAGEPROC            glBufferStorage;
+
 // Load all GL 2.0+ function pointers via glfwGetProcAddress.
-// Call AFTER glfwMakeContextCurrent(). Returns true on success.
+// Call AFTER glfwMakeContextCurrent(). Returns true on success; optional
+// extension entry points are left null when unavailable.
 bool loadGL();
@@ -2,12 +2,292 @@
 #include "config.h"
 #include "simulation.h"
 #include "renderer.h"
+#include "cpu_renderer.h"
+#include "surface.h"
+#include "scenario.h"
+#include "state_export.h"
+#include "telemetry.h"
+#include "replay.h"
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
-#include <ctime>
+#include <cstring>
+#include <vector>
 
-int main() {
-    std::srand((unsigned)std::time(nullptr));
+// Simulate and render `frames` frames on the CPU with no window, writing
+// each one to <prefix>NNNNN.ppm (or nowhere if prefix is empty). With
+// `surface`, the contour is extracted too and saved as <prefix>NNNNN.svg.
+static int runHeadless(const Scenario& scenario, int frames, const char* prefix, bool surface,
+                       bool compactForces) {
+    SPHSimulation sim(scenario);
+    sim.compactForces = compactForces;
+    sim.initScene();
+    CpuRenderer renderer(scenario.width, scenario.height);
+    SurfaceExtractor extractor(cfg::SURFACE_CELL);
+
+    double simMs = 0.0, splatMs = 0.0, compositeMs = 0.0, surfaceMs = 0.0, writeMs = 0.0;
+    long   surfaceCells = 0;
+    for (int f = 0; f < frames; f++) {
+        auto t0 = std::chrono::steady_clock::now();
+        sim.update();
+        auto t1 = std::chrono::steady_clock::now();
+        renderer.render(sim);
+        if (surface) {
+            extractor.update(sim);
+            surfaceMs += extractor.stats.densityMs + extractor.stats.contourMs + extractor.stats.linkMs;
+            surfaceCells += extractor.stats.dirtyCells;
+        }
+        auto t2 = std::chrono::steady_clock::now();
+
+        if (prefix[0]) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s%05d.ppm", prefix, f);
+            if (!renderer.writePPM(path)) return 1;
+            if (surface) {
+                snprintf(path, sizeof(path), "%s%05d.svg", prefix, f);
+                if (!extractor.writeSVG(path)) return 1;
+            }
+        }
+        auto t3 = std::chrono::steady_clock::now();
+
+        simMs       += std::chrono::duration<double, std::milli>(t1 - t0).count();
+        splatMs     += renderer.splatMs;
+        compositeMs += renderer.compositeMs;
+        writeMs     += std::chrono::duration<double, std::milli>(t3 - t2).count();
+    }
+
+    printf("%d frames, %d particles, %dx%d\n", frames, sim.count, scenario.width, scenario.height);
+    printf("grid: %d tiles in use, %.1f KB\n", sim.gridTiles(), sim.gridBytes() / 1024.0);
+    printf("per frame: sim %.2f ms, splat %.2f ms, composite %.2f ms, write %.2f ms\n",
+           simMs / frames, splatMs / frames, compositeMs / frames, writeMs / frames);
+    if (surface)
+        printf("surface: %.2f ms, %ld cells re-contoured per frame\n",
+               surfaceMs / frames, surfaceCells / frames);
+    return 0;
+}
+
+// Move the view by (dx, dy), keeping it inside the domain on every side
+// where the domain is at least as large as the window
+static void panView(const SPHSimulation& sim, int width, int height, float dx, float dy,
+                    float& viewX, float& viewY) {
+    const Scenario::Block& d = sim.bounds;
+    viewX += dx;
+    viewY += dy;
+    if (viewX > d.x1 - width)  viewX = d.x1 - width;
+    if (viewX < d.x0)          viewX = d.x0;
+    if (viewY > d.y1 - height) viewY = d.y1 - height;
+    if (viewY < d.y0)          viewY = d.y0;
+}
+
+// Render the same frames through a full-resolution renderer and one whose
+// splat target is 1/divisor the size, and report how far apart the final
+// images are and what each pass costs on the GPU. Needs a GL context.
+static int runSplatCompare(GLFWwindow* window, const Scenario& scenario,
+                           UploadOptions upload, int divisor, int frames) {
+    SPHSimulation sim(scenario);
+    sim.initScene();
+    FluidRenderer full(scenario.width, scenario.height, sim.capacity, upload);
+    FluidRenderer reduced(scenario.width, scenario.height, sim.capacity, upload, divisor);
+
+    std::vector<unsigned char> a, b;
+    double fullSplat = 0.0, fullComposite = 0.0, redSplat = 0.0, redComposite = 0.0;
+    double absDiff = 0.0, differing = 0.0;
+    int    timed = 0;
+    for (int f = 0; f < frames; f++) {
+        sim.update();
+        full.render(sim);
+        full.readPixels(a);
+        reduced.render(sim);
+        reduced.readPixels(b);
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+
+        long sum = 0, count = 0;
+        for (size_t k = 0; k < a.size(); k += 3) {
+            int d = std::abs(a[k] - b[k]) + std::abs(a[k + 1] - b[k + 1]) + std::abs(a[k + 2] - b[k + 2]);
+            sum += d;
+            if (d > 6) count++;   // more than ~2 levels per channel
+        }
+        absDiff   += (double)sum / (double)a.size();
+        differing += (double)count / (double)(a.size() / 3);
+
+        // Timer results lag QUERY_FRAMES behind; skip the warm-up zeros
+        if (f >= 8) {
+            fullSplat     += full.splatMs;
+            fullComposite += full.compositeMs;
+            redSplat      += reduced.splatMs;
+            redComposite  += reduced.compositeMs;
+            timed++;
+        }
+    }
+
+    timed = timed > 0 ? timed : 1;
+    printf("%d frames, %d particles, %dx%d, splat target 1/%d\n",
+           frames, sim.count, scenario.width, scenario.height, divisor);
+    printf("full res:  splat %.3f ms, composite %.3f ms\n", fullSplat / timed, fullComposite / timed);
+    printf("reduced:   splat %.3f ms, composite %.3f ms\n", redSplat / timed, redComposite / timed);
+    printf("image difference: mean %.3f / 255 per channel, %.2f%% of pixels differ\n",
+           absDiff / frames, 100.0 * differing / frames);
+    return 0;
+}
+
+// Step through a recorded session as fast as the simulation runs, checking
+// each frame's state against the hash recorded with it. The force pass comes
+// from the log; asking for the other one is an error, since every hash would
+// then miss.
+static int runReplay(const InputLog& log, bool compactForces) {
+    if (compactForces && !log.compactForces) {
+        fprintf(stderr, "--compact-forces: the log was recorded with the float force pass\n");
+        return 1;
+    }
+    SPHSimulation sim(log.scenario);
+    sim.compactForces = log.compactForces;
+    sim.initScene();
+
+    SPHSimulation::PhaseTimings sum;
+    double frameMs = 0.0, worstMs = 0.0;
+    long   particles = 0;
+    int    diverged = -1;
+    for (size_t f = 0; f < log.frames.size(); f++) {
+        auto t0 = std::chrono::steady_clock::now();
+        stepFrame(sim, log.frames[f]);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+        frameMs += ms;
+        if (ms > worstMs) worstMs = ms;
+        particles     += sim.count;
+        sum.grid      += sim.timings.grid;
+        sum.density   += sim.timings.density;
+        sum.forces    += sim.timings.forces;
+        sum.integrate += sim.timings.integrate;
+        sum.adapt     += sim.timings.adapt;
+        if (diverged < 0 && (uint32_t)sim.stateHash() != log.hashes[f]) diverged = (int)f;
+    }
+
+    int n = log.frames.empty() ? 1 : (int)log.frames.size();
+    printf("%d frames, %ld particles on average\n", (int)log.frames.size(), particles / n);
+    printf("per frame: %.3f ms (worst %.3f) = grid %.3f, density %.3f, forces %.3f, integrate %.3f, adapt %.3f\n",
+           frameMs / n, worstMs, sum.grid / n, sum.density / n, sum.forces / n, sum.integrate / n, sum.adapt / n);
+    if (diverged >= 0) {
+        printf("state diverged from the recording at frame %d\n", diverged);
+        return 1;
+    }
+    printf("state matched the recording on every frame\n");
+    return 0;
+}
+
+// Time the float and compact force passes on the scenario after it has run
+// `frames` frames, and report how far the compact forces drift from the
+// float ones.
+static int runForceBench(const Scenario& scenario, int frames) {
+    SPHSimulation sim(scenario);
+    sim.initScene();
+    for (int f = 0; f < frames; f++) sim.update();
+
+    SPHSimulation::ForceBench bench = sim.benchForces(20);
+    printf("%d particles after %d frames\n", sim.count, frames);
+    printf("forces: float %.3f ms, compact %.3f ms (%.2fx)\n",
+           bench.floatMs, bench.compactMs,
+           bench.compactMs > 0.0 ? bench.floatMs / bench.compactMs : 0.0);
+    printf("compact error vs float, relative to the largest force: max %.2e, rms %.2e\n",
+           bench.maxError, bench.rmsError);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // --scenario file loads a scenario; --key=value overrides one setting
+    // --export-shm [name] publishes particle state to shared memory
+    // --telemetry [path] serves live metrics on a Unix domain socket
+    // --headless N renders N frames on the CPU; --frames prefix saves them
+    // --surface extracts the fluid contour every frame
+    // --split-streams / --no-persistent choose the particle upload path
+    // --splat-divisor N splats at 1/N resolution (1, 2 or 4)
+    // --splat-compare N measures 1/N against full resolution and exits
+    // --cull-interior splats surface particles only, over a coarse interior layer
+    // --compact-forces reads neighbours from quantized state in the force pass
+    // --bench-forces N compares both force passes after N frames and exits
+    // --record file logs every frame's input; --replay file plays one back headless
+    Scenario scenario;
+    UploadOptions upload;
+    bool surface = false;
+    int splatDivisor = 1;
+    int compareDivisor = 0;
+    bool cullInterior = false;
+    bool compactForces = false;
+    int benchFrames = -1;
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    int headlessFrames = 0;
+    const char* framePrefix = "";
+    const char* shmName = nullptr;
+    const char* telemetryPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--scenario") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--scenario needs a file name\n");
+                return 1;
+            }
+            if (!loadScenario(argv[++i], scenario)) return 1;
+        } else if (std::strcmp(argv[i], "--export-shm") == 0) {
+            shmName = (i + 1 < argc && argv[i + 1][0] == '/') ? argv[++i]
+                                                              : shmstate::DEFAULT_NAME;
+        } else if (std::strcmp(argv[i], "--telemetry") == 0) {
+            telemetryPath = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i]
+                                                                    : "/tmp/liquidsim.sock";
+        } else if (std::strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            headlessFrames = std::atoi(argv[++i]);
+            if (headlessFrames <= 0) {
+                fprintf(stderr, "--headless needs a positive frame count\n");
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            framePrefix = argv[++i];
+        } else if (std::strcmp(argv[i], "--surface") == 0) {
+            surface = true;
+        } else if (std::strcmp(argv[i], "--split-streams") == 0) {
+            upload.splitStreams = true;
+        } else if (std::strcmp(argv[i], "--no-persistent") == 0) {
+            upload.persistent = false;
+        } else if (std::strcmp(argv[i], "--cull-interior") == 0) {
+            cullInterior = true;
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--compact-forces") == 0) {
+            compactForces = true;
+        } else if (std::strcmp(argv[i], "--bench-forces") == 0 && i + 1 < argc) {
+            benchFrames = std::atoi(argv[++i]);
+            if (benchFrames < 0) {
+                fprintf(stderr, "--bench-forces needs a frame count\n");
+                return 1;
+            }
+        } else if ((std::strcmp(argv[i], "--splat-divisor") == 0 ||
+                    std::strcmp(argv[i], "--splat-compare") == 0) && i + 1 < argc) {
+            int& divisor = std::strcmp(argv[i], "--splat-divisor") == 0 ? splatDivisor : compareDivisor;
+            divisor = std::atoi(argv[i + 1]);
+            if (divisor != 1 && divisor != 2 && divisor != 4) {
+                fprintf(stderr, "%s must be 1, 2 or 4\n", argv[i]);
+                return 1;
+            }
+            i++;
+        } else if (!applyScenarioOption(argv[i], scenario)) {
+            fprintf(stderr, "Unknown or invalid option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!validateScenario(scenario)) return 1;
+
+    if (replayPath) {
+        // The log carries its own scenario
+        InputLog log;
+        if (!log.load(replayPath) || !validateScenario(log.scenario)) return 1;
+        return runReplay(log, compactForces);
+    }
+    if (benchFrames >= 0)
+        return runForceBench(scenario, benchFrames);
+    if (headlessFrames > 0)
+        return runHeadless(scenario, headlessFrames, framePrefix, surface, compactForces);
 
     if (!glfwInit()) {
         fprintf(stderr, "Failed to init GLFW\n");
@@ -19,7 +299,7 @@ int main() {
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-    GLFWwindow* window = glfwCreateWindow(cfg::WIDTH, cfg::HEIGHT,
+    GLFWwindow* window = glfwCreateWindow(scenario.width, scenario.height,
                                           "Liquid Simulation", nullptr, nullptr);
     if (!window) {
         fprintf(stderr, "Failed to create GLFW window (OpenGL 3.3 required)\n");
@@ -36,14 +316,49 @@ int main() {
         return 1;
     }
 
-    SPHSimulation sim(cfg::WIDTH, cfg::HEIGHT);
-    sim.initDamBreak();
+    if (compareDivisor > 0) {
+        int result = runSplatCompare(window, scenario, upload, compareDivisor, 300);
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return result;
+    }
+
+    SPHSimulation sim(scenario);
+    sim.compactForces = compactForces;
+    sim.initScene();
+
+    FluidRenderer renderer(scenario.width, scenario.height, sim.capacity, upload, splatDivisor);
+    renderer.cullInterior = cullInterior;
+    printf("Particle upload: %s, %s\n",
+           renderer.persistentUpload ? "persistent mapped ring" : "orphaned buffer",
+           upload.splitStreams ? "split x/y streams" : "interleaved");
+    SurfaceExtractor extractor(cfg::SURFACE_CELL);
+
+    StateExporter exporter;
+    if (shmName && exporter.open(shmName, sim.capacity, sim.bounds.x0, sim.bounds.y0, sim.bounds.x1, sim.bounds.y1))
+        printf("Exporting particle state to shared memory %s\n", shmName);
+
+    TelemetryServer telemetry;
+    if (telemetryPath && telemetry.start(telemetryPath))
+        printf("Serving telemetry on %s\n", telemetryPath);
 
-    FluidRenderer renderer(cfg::WIDTH, cfg::HEIGHT);
+    InputRecorder recorder;
+    if (recordPath && recorder.open(recordPath, scenario, compactForces))
+        printf("Recording input to %s\n", recordPath);
 
     // FPS tracking
     double lastTime = glfwGetTime();
     int    frameCount = 0;
+    bool   adaptKeyWasDown = false;
+
+    // Arrow keys pan over domains larger than the window
+    float viewX = 0.0f, viewY = 0.0f;
+    panView(sim, scenario.width, scenario.height, 0.0f, 0.0f, viewX, viewY);
+
+    // Telemetry frame bookkeeping
+    uint64_t frameIndex  = 0;
+    double   frameStart  = glfwGetTime();
+    uint64_t allocsStart = allocationCount();
 
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
@@ -51,43 +366,86 @@ int main() {
         // ---- Input ----
         double mx, my;
         glfwGetCursorPos(window, &mx, &my);
-        bool mouseDown = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
 
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
             glfwSetWindowShouldClose(window, GLFW_TRUE);
 
-        if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
-            sim.initDamBreak();
+        float pan = cfg::PAN_SPEED;
+        panView(sim, scenario.width, scenario.height,
+                pan * ((glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) -
+                       (glfwGetKey(window, GLFW_KEY_LEFT)  == GLFW_PRESS)),
+                pan * ((glfwGetKey(window, GLFW_KEY_DOWN)  == GLFW_PRESS) -
+                       (glfwGetKey(window, GLFW_KEY_UP)    == GLFW_PRESS)),
+                viewX, viewY);
+        renderer.viewX = viewX;
+        renderer.viewY = viewY;
+
+        // The cursor in simulation coordinates
+        FrameInput input;
+        input.mouseX    = (float)mx + viewX;
+        input.mouseY    = (float)my + viewY;
+        input.mouseDown = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        input.reset     = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+
+        // A toggles adaptive particle resolution
+        bool adaptKeyDown = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+        input.toggleAdaptive = adaptKeyDown && !adaptKeyWasDown;
+        adaptKeyWasDown = adaptKeyDown;
 
         // Faucet — hold F to pour particles at cursor
-        if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && sim.count < cfg::MAX_PARTICLES) {
-            for (int i = 0; i < 4; i++) {
-                sim.addParticle(
-                    (float)mx + ((rand() / (float)RAND_MAX) - 0.5f) * 10.0f,
-                    (float)my + ((rand() / (float)RAND_MAX) - 0.5f) * 10.0f,
-                    ((rand() / (float)RAND_MAX) - 0.5f) * 50.0f,
-                    200.0f + (rand() / (float)RAND_MAX) * 100.0f
-                );
-            }
-        }
+        input.pour = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
 
         // ---- Simulate ----
-        sim.applyMouseForce((float)mx, (float)my, mouseDown);
-        sim.update();
+        stepFrame(sim, input);
+        recorder.record(input, sim);
+        exporter.publish(sim);
+        if (surface) extractor.update(sim);
 
         // ---- Render ----
         renderer.render(sim);
         glfwSwapBuffers(window);
 
+        // ---- Telemetry ----
+        if (telemetry.isRunning()) {
+            double   frameEnd  = glfwGetTime();
+            uint64_t allocsEnd = allocationCount();
+
+            TelemetryMetrics m;
+            m.frame       = frameIndex;
+            m.frameMs     = (frameEnd - frameStart) * 1000.0;
+            m.fps         = m.frameMs > 0.0 ? 1000.0 / m.frameMs : 0.0;
+            m.particles   = sim.count;
+            m.substeps    = sim.timings.substeps;
+            m.gridMs      = sim.timings.grid;
+            m.densityMs   = sim.timings.density;
+            m.forcesMs    = sim.timings.forces;
+            m.integrateMs = sim.timings.integrate;
+            m.adaptMs     = sim.timings.adapt;
+            m.splatMs     = renderer.splatMs;
+            m.compositeMs = renderer.compositeMs;
+            m.uploadMs    = renderer.uploadMs;
+            if (surface) {
+                m.surfaceMs    = extractor.stats.densityMs + extractor.stats.contourMs + extractor.stats.linkMs;
+                m.surfaceCells = extractor.stats.dirtyCells;
+            }
+            m.allocations      = allocsEnd - allocsStart;
+            m.allocationsTotal = allocsEnd;
+            telemetry.publish(m);
+
+            frameStart  = frameEnd;
+            allocsStart = allocsEnd;
+        }
+        frameIndex++;
+
         // ---- FPS title bar ----
         frameCount++;
         double now = glfwGetTime();
         if (now - lastTime >= 0.5) {
             int fps = (int)(frameCount / (now - lastTime));
-            char title[128];
+            char title[256];
             snprintf(title, sizeof(title),
-                     "Liquid Simulation  |  FPS: %d  |  Particles: %d  |  [Click] push  [F] pour  [R] reset  [Esc] quit",
-                     fps, sim.count);
+                     "Liquid Simulation  |  FPS: %d  |  Particles: %d%s  |  [Click] push  [F] pour  [A] adaptive  [R] reset  [Arrows] pan  [Esc] quit",
+                     fps, sim.count, sim.adaptive ? " (adaptive)" : "");
             glfwSetWindowTitle(window, title);
             frameCount = 0;
             lastTime = now;
@@ -1,7 +1,11 @@
 #include "renderer.h"
 #include "simulation.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 // ============================================================
 // GLSL shaders (OpenGL 3.3 Core)
@@ -9,11 +13,13 @@
 
 static const char* SPLAT_VS = R"(
 #version 330 core
-layout(location = 0) in vec2 a_position;
+layout(location = 0) in float a_x;
+layout(location = 1) in float a_y;
 uniform vec2  u_resolution;
+uniform vec2  u_view;
 uniform float u_pointSize;
 void main() {
-    vec2 clip = (a_position / u_resolution) * 2.0 - 1.0;
+    vec2 clip = ((vec2(a_x, a_y) - u_view) / u_resolution) * 2.0 - 1.0;
     clip.y = -clip.y;
     gl_Position = vec4(clip, 0.0, 1.0);
     gl_PointSize = u_pointSize;
@@ -43,24 +49,87 @@ void main() {
 }
 )";
 
+// Coarse stand-in for the interior particles' splats, added into the splat
+// target. Texture rows run top-down like the simulation's y axis. A cubic
+// B-spline, taken as four bilinear fetches, keeps the density's slope
+// continuous across texel edges; bilinear filtering alone leaves kinks that
+// the fluid pass's gradient normals show up as a grid.
+static const char* INTERIOR_FS = R"(
+#version 330 core
+uniform sampler2D u_texture;
+uniform vec2 u_scale;
+in  vec2 v_texCoord;
+out vec4 fragColor;
+void main() {
+    vec2 size = vec2(textureSize(u_texture, 0));
+    vec2 p = vec2(v_texCoord.x, 1.0 - v_texCoord.y) * u_scale * size - 0.5;
+    vec2 i = floor(p);
+    vec2 f = p - i;
+
+    vec2 w0 = (1.0 - f) * (1.0 - f) * (1.0 - f) / 6.0;
+    vec2 w1 = (4.0 - 6.0 * f * f + 3.0 * f * f * f) / 6.0;
+    vec2 w3 = f * f * f / 6.0;
+    vec2 w2 = 1.0 - w0 - w1 - w3;
+    vec2 g0 = w0 + w1, g1 = w2 + w3;
+    vec2 c0 = (i - 0.5 + w1 / g0) / size;
+    vec2 c1 = (i + 1.5 + w3 / g1) / size;
+
+    float d = g0.y * (g0.x * texture(u_texture, vec2(c0.x, c0.y)).r +
+                      g1.x * texture(u_texture, vec2(c1.x, c0.y)).r) +
+              g1.y * (g0.x * texture(u_texture, vec2(c0.x, c1.y)).r +
+                      g1.x * texture(u_texture, vec2(c1.x, c1.y)).r);
+    fragColor = vec4(d, d, d, 1.0);
+}
+)";
+
 static const char* FLUID_FS = R"(
 #version 330 core
 uniform sampler2D u_texture;
 uniform vec2  u_resolution;
 uniform float u_threshold;
+uniform int   u_divisor;
 in  vec2 v_texCoord;
 out vec4 fragColor;
 
+// Density at uv. A reduced splat target is upsampled with a Catmull-Rom
+// filter over the surrounding 4x4 texels: it passes through every texel
+// value and keeps the slope across the threshold steep, where bilinear
+// filtering rounds off thin sheets and droplets.
+vec4 catmullRom(float t) {
+    return vec4(((-0.5 * t + 1.0) * t - 0.5) * t, (1.5 * t - 2.5) * t * t + 1.0,
+                ((-1.5 * t + 2.0) * t + 0.5) * t, (0.5 * t - 0.5) * t * t);
+}
+
+float sampleDensity(vec2 uv) {
+    if (u_divisor == 1) return texture(u_texture, uv).r;
+
+    ivec2 size = textureSize(u_texture, 0);
+    vec2  p = uv * vec2(size) - 0.5;
+    vec2  f = fract(p);
+    ivec2 i = ivec2(floor(p));
+    ivec2 lo = ivec2(0), hi = size - 1;
+    vec4 wx = catmullRom(f.x), wy = catmullRom(f.y);
+    float sum = 0.0;
+    for (int y = 0; y < 4; y++) {
+        vec4 row = vec4(texelFetch(u_texture, clamp(i + ivec2(-1, y - 1), lo, hi), 0).r,
+                        texelFetch(u_texture, clamp(i + ivec2( 0, y - 1), lo, hi), 0).r,
+                        texelFetch(u_texture, clamp(i + ivec2( 1, y - 1), lo, hi), 0).r,
+                        texelFetch(u_texture, clamp(i + ivec2( 2, y - 1), lo, hi), 0).r);
+        sum += dot(row, wx) * wy[y];
+    }
+    return sum;
+}
+
 void main() {
-    float density = texture(u_texture, v_texCoord).r;
+    float density = sampleDensity(v_texCoord);
     if (density < u_threshold) discard;
 
     // Surface normal from density gradient
     vec2 texel = 1.0 / u_resolution;
-    float dL = texture(u_texture, v_texCoord - vec2(texel.x, 0)).r;
-    float dR = texture(u_texture, v_texCoord + vec2(texel.x, 0)).r;
-    float dD = texture(u_texture, v_texCoord - vec2(0, texel.y)).r;
-    float dU = texture(u_texture, v_texCoord + vec2(0, texel.y)).r;
+    float dL = sampleDensity(v_texCoord - vec2(texel.x, 0));
+    float dR = sampleDensity(v_texCoord + vec2(texel.x, 0));
+    float dD = sampleDensity(v_texCoord - vec2(0, texel.y));
+    float dU = sampleDensity(v_texCoord + vec2(0, texel.y));
     vec3 normal = normalize(vec3(dL - dR, dD - dU, 0.18));
 
     // Lighting
@@ -80,9 +149,14 @@ void main() {
 }
 )";
 
+// Walls are drawn along the simulation's domain edges, which need not be
+// the window's: u_domain is x0, y0, x1, y1 in simulation pixels, with open
+// sides pushed far out of view.
 static const char* BG_FS = R"(
 #version 330 core
 uniform vec2 u_resolution;
+uniform vec2 u_view;
+uniform vec4 u_domain;
 uniform float u_wallThickness;
 in  vec2 v_texCoord;
 out vec4 fragColor;
@@ -90,12 +164,12 @@ out vec4 fragColor;
 void main() {
     vec3 bg = mix(vec3(0.07, 0.07, 0.11), vec3(0.03, 0.03, 0.06), v_texCoord.y);
 
-    // Container walls
-    vec2 px = gl_FragCoord.xy;
+    // Container walls, and everything past them
+    vec2 px = vec2(gl_FragCoord.x, u_resolution.y - gl_FragCoord.y) + u_view;
     float wall = u_wallThickness;
     float edge = 0.0;
-    if (px.x < wall || px.x > u_resolution.x - wall ||
-        px.y < wall || px.y > u_resolution.y - wall) {
+    if (px.x < u_domain.x + wall || px.x > u_domain.z - wall ||
+        px.y < u_domain.y + wall || px.y > u_domain.w - wall) {
         edge = 1.0;
     }
     vec3 wallColor = vec3(0.30, 0.36, 0.48);
@@ -107,29 +181,44 @@ void main() {
 // Implementation
 // ============================================================
 
-FluidRenderer::FluidRenderer(int w, int h) : width(w), height(h) {
+FluidRenderer::FluidRenderer(int w, int h, int maxParticles, UploadOptions uploadOptions, int divisor)
+    : width(w), height(h), capacity(maxParticles), upload(uploadOptions),
+      splatDivisor(divisor < 1 ? 1 : divisor) {
+    splatW = (width  + splatDivisor - 1) / splatDivisor;
+    splatH = (height + splatDivisor - 1) / splatDivisor;
+
     splatProg = compileProgram(SPLAT_VS, SPLAT_FS);
     fluidProg = compileProgram(QUAD_VS,  FLUID_FS);
     bgProg    = compileProgram(QUAD_VS,  BG_FS);
+    interiorProg = compileProgram(QUAD_VS, INTERIOR_FS);
 
     // Cache uniform locations
     glUseProgram(splatProg);
     splat_uRes    = glGetUniformLocation(splatProg, "u_resolution");
+    splat_uView   = glGetUniformLocation(splatProg, "u_view");
     splat_uPtSize = glGetUniformLocation(splatProg, "u_pointSize");
 
     glUseProgram(fluidProg);
     fluid_uTex    = glGetUniformLocation(fluidProg, "u_texture");
     fluid_uRes    = glGetUniformLocation(fluidProg, "u_resolution");
     fluid_uThresh = glGetUniformLocation(fluidProg, "u_threshold");
+    fluid_uDivisor = glGetUniformLocation(fluidProg, "u_divisor");
 
     glUseProgram(bgProg);
     bg_uRes  = glGetUniformLocation(bgProg, "u_resolution");
+    bg_uView   = glGetUniformLocation(bgProg, "u_view");
+    bg_uDomain = glGetUniformLocation(bgProg, "u_domain");
     bg_uWall = glGetUniformLocation(bgProg, "u_wallThickness");
 
+    glUseProgram(interiorProg);
+    interior_uTex   = glGetUniformLocation(interiorProg, "u_texture");
+    interior_uScale = glGetUniformLocation(interiorProg, "u_scale");
+
     glUseProgram(0);
 
     setupGeometry();
     setupFBO();
+    glGenQueries(QUERY_FRAMES * 2, &timerQueries[0][0]);
 
     glEnable(GL_PROGRAM_POINT_SIZE);
 }
@@ -138,12 +227,21 @@ FluidRenderer::~FluidRenderer() {
     glDeleteProgram(splatProg);
     glDeleteProgram(fluidProg);
     glDeleteProgram(bgProg);
+    glDeleteProgram(interiorProg);
+    for (GLsync& fence : regionFence)
+        if (fence) glDeleteSync(fence);
+    if (mapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
     glDeleteVertexArrays(1, &particleVAO);
     glDeleteBuffers(1, &particleVBO);
     glDeleteVertexArrays(1, &quadVAO);
     glDeleteBuffers(1, &quadVBO);
     glDeleteFramebuffers(1, &splatFBO);
     glDeleteTextures(1, &splatTex);
+    glDeleteTextures(1, &interiorTex);
+    glDeleteQueries(QUERY_FRAMES * 2, &timerQueries[0][0]);
 }
 
 void FluidRenderer::setupGeometry() {
@@ -153,9 +251,40 @@ void FluidRenderer::setupGeometry() {
 
     glBindVertexArray(particleVAO);
     glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(posData), nullptr, GL_DYNAMIC_DRAW);
+
+    const GLsizeiptr stream = (GLsizeiptr)capacity * sizeof(float);
+    if (upload.persistent && glBufferStorage) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const GLsizeiptr size  = stream * 2 * UPLOAD_REGIONS;
+        glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+        mapped = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+        persistentUpload = mapped != nullptr;
+
+        if (!persistentUpload) {
+            // Immutable storage can't be respecified; start over with a plain buffer
+            fprintf(stderr, "Persistent mapping failed, falling back to buffer orphaning\n");
+            glDeleteBuffers(1, &particleVBO);
+            glGenBuffers(1, &particleVBO);
+            glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
+        }
+    }
+    if (!persistentUpload) {
+        glBufferData(GL_ARRAY_BUFFER, stream * 2, nullptr, GL_STREAM_DRAW);
+        if (!upload.splitStreams) posData.resize((size_t)capacity * 2);
+    }
+
+    // Attribute 0 is x and 1 is y, either interleaved in one stream or as
+    // two planar streams (every region's x values, then every region's y)
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glEnableVertexAttribArray(1);
+    if (upload.splitStreams) {
+        GLsizeiptr yOffset = stream * (persistentUpload ? UPLOAD_REGIONS : 1);
+        glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 0, (void*)yOffset);
+    } else {
+        glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)sizeof(float));
+    }
     glBindVertexArray(0);
 
     // Fullscreen quad VAO/VBO
@@ -183,7 +312,20 @@ void FluidRenderer::setupGeometry() {
 void FluidRenderer::setupFBO() {
     glGenTextures(1, &splatTex);
     glBindTexture(GL_TEXTURE_2D, splatTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, splatW, splatH, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    interiorW = (int)ceilf(width  / cfg::INTERIOR_CELL);
+    interiorH = (int)ceilf(height / cfg::INTERIOR_CELL);
+    interiorData.assign((size_t)interiorW * interiorH, 0.0f);
+    surfX.reserve(capacity);
+    surfY.reserve(capacity);
+    glGenTextures(1, &interiorTex);
+    glBindTexture(GL_TEXTURE_2D, interiorTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, interiorW, interiorH, 0, GL_RED, GL_FLOAT, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -199,32 +341,182 @@ void FluidRenderer::setupFBO() {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void FluidRenderer::render(const SPHSimulation& sim) {
-    // Upload particle positions
+// Gather the particles to splat into surfX/surfY: those near the view when
+// the domain reaches past it, and of those only the surface ones when
+// culling the interior. Each culled interior particle's splat is scattered
+// onto the coarse texels around it with bilinear weights instead. A splat
+// adds POINT_SIZE^2 * pi/18 * (1 - e^-4.5) in total, so that is spread over
+// the texel area; filtering the texture on the way back then blurs the
+// layer by about the width of the splat's Gaussian.
+void FluidRenderer::gatherSplats(const SPHSimulation& sim, bool clip) {
+    const float cell   = cfg::INTERIOR_CELL;
+    const float weight = cfg::POINT_SIZE * cfg::POINT_SIZE * 0.17453293f * (1.0f - expf(-4.5f))
+                       / (cell * cell);
+    const float margin = cfg::POINT_SIZE * 0.5f;
+    const float x0 = viewX - margin, x1 = viewX + width  + margin;
+    const float y0 = viewY - margin, y1 = viewY + height + margin;
+
+    surfX.clear();
+    surfY.clear();
+    if (cullInterior) std::fill(interiorData.begin(), interiorData.end(), 0.0f);
     for (int i = 0; i < sim.count; i++) {
-        posData[i * 2]     = sim.posX[i];
-        posData[i * 2 + 1] = sim.posY[i];
+        float x = sim.posX[i], y = sim.posY[i];
+        if (clip && (x < x0 || x > x1 || y < y0 || y > y1)) continue;
+        if (!cullInterior || sim.onSurface[i]) {
+            surfX.push_back(x);
+            surfY.push_back(y);
+            continue;
+        }
+
+        float fx = (x - viewX) / cell - 0.5f, fy = (y - viewY) / cell - 0.5f;
+        int   ix = (int)floorf(fx),  iy = (int)floorf(fy);
+        float tx = fx - (float)ix,   ty = fy - (float)iy;
+        for (int k = 0; k < 4; k++) {
+            int nx = ix + (k & 1), ny = iy + (k >> 1);
+            if (nx < 0 || ny < 0 || nx >= interiorW || ny >= interiorH) continue;
+            float w = ((k & 1) ? tx : 1.0f - tx) * ((k >> 1) ? ty : 1.0f - ty);
+            interiorData[(size_t)ny * interiorW + nx] += w * weight;
+        }
+    }
+
+    if (!cullInterior) return;
+    glBindTexture(GL_TEXTURE_2D, interiorTex);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, interiorW, interiorH, GL_RED, GL_FLOAT, interiorData.data());
+}
+
+// Hand this frame's positions to GL and return the first vertex to draw.
+// splatCount is set to the number of vertices written.
+int FluidRenderer::uploadPositions(const SPHSimulation& sim) {
+    const float* xs = sim.posX.data();
+    const float* ys = sim.posY.data();
+    int n = sim.count;
+
+    // Skip particles out of view only when the domain extends past the
+    // window; otherwise nearly all of them are on screen anyway
+    const Scenario::Block& d = sim.bounds;
+    bool clip = d.x0 < viewX || d.y0 < viewY || d.x1 > viewX + width || d.y1 > viewY + height;
+    if (cullInterior || clip) {
+        gatherSplats(sim, clip);
+        xs = surfX.data();
+        ys = surfY.data();
+        n  = (int)surfX.size();
     }
+    splatCount = n;
+    const size_t bytes = (size_t)n * sizeof(float);
+
+    if (persistentUpload) {
+        region = (region + 1) % UPLOAD_REGIONS;
+
+        // The draw that last read this region was UPLOAD_REGIONS frames ago,
+        // so this normally returns at once
+        if (regionFence[region]) {
+            GLenum r;
+            do {
+                r = glClientWaitSync(regionFence[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            } while (r == GL_TIMEOUT_EXPIRED);
+            glDeleteSync(regionFence[region]);
+            regionFence[region] = nullptr;
+        }
+
+        const int first = region * capacity;
+        if (upload.splitStreams) {
+            std::memcpy(mapped + first, xs, bytes);
+            std::memcpy(mapped + (size_t)capacity * UPLOAD_REGIONS + first, ys, bytes);
+        } else {
+            float* dst = mapped + (size_t)first * 2;
+            for (int i = 0; i < n; i++) {
+                dst[i * 2]     = xs[i];
+                dst[i * 2 + 1] = ys[i];
+            }
+        }
+        return first;
+    }
+
+    // Orphan the old storage so the driver never has to wait for the
+    // previous frame's draw before accepting new data
     glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sim.count * 2 * sizeof(float), posData);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * 2 * sizeof(float), nullptr, GL_STREAM_DRAW);
+    if (upload.splitStreams) {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, xs);
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)capacity * sizeof(float), bytes, ys);
+    } else {
+        for (int i = 0; i < n; i++) {
+            posData[i * 2]     = xs[i];
+            posData[i * 2 + 1] = ys[i];
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes * 2, posData.data());
+    }
+    return 0;
+}
+
+// Collect the pass times from a slot's queries if the GPU has finished them.
+// A slot that is still in flight is simply re-issued; we lose one sample
+// rather than stall.
+void FluidRenderer::readTimers(int slot) {
+    if (!timerPending[slot]) return;
+    timerPending[slot] = false;
+
+    GLint ready = 0;
+    glGetQueryObjectiv(timerQueries[slot][1], GL_QUERY_RESULT_AVAILABLE, &ready);
+    if (!ready) return;
+
+    GLuint64 ns[2];
+    glGetQueryObjectui64v(timerQueries[slot][0], GL_QUERY_RESULT, &ns[0]);
+    glGetQueryObjectui64v(timerQueries[slot][1], GL_QUERY_RESULT, &ns[1]);
+    splatMs     = (float)(ns[0] * 1e-6);
+    compositeMs = (float)(ns[1] * 1e-6);
+}
+
+// Infinite domain edges as a finite distance no view will reach
+static float openEdge(float e) {
+    return std::min(std::max(e, -1e30f), 1e30f);
+}
+
+void FluidRenderer::render(const SPHSimulation& sim) {
+    const Scenario::Block& d = sim.bounds;
+    int slot = timerFrame;
+    timerFrame = (timerFrame + 1) % QUERY_FRAMES;
+    readTimers(slot);
+
+    // Upload particle positions
+    auto uploadStart = std::chrono::steady_clock::now();
+    int first = uploadPositions(sim);
+    uploadMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
 
     // ---- Pass 1: Splat particles to FBO (additive) ----
+    glBeginQuery(GL_TIME_ELAPSED, timerQueries[slot][0]);
     glBindFramebuffer(GL_FRAMEBUFFER, splatFBO);
-    glViewport(0, 0, width, height);
+    glViewport(0, 0, splatW, splatH);
     glClearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_ONE, GL_ONE);
 
+    if (cullInterior) {
+        glUseProgram(interiorProg);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, interiorTex);
+        glUniform1i(interior_uTex, 0);
+        glUniform2f(interior_uScale, (float)width  / (interiorW * cfg::INTERIOR_CELL),
+                                     (float)height / (interiorH * cfg::INTERIOR_CELL));
+        glBindVertexArray(quadVAO);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
     glUseProgram(splatProg);
     glUniform2f(splat_uRes, (float)width, (float)height);
-    glUniform1f(splat_uPtSize, cfg::POINT_SIZE);
+    glUniform2f(splat_uView, viewX, viewY);
+    glUniform1f(splat_uPtSize, cfg::POINT_SIZE * (float)splatW / (float)width);
 
     glBindVertexArray(particleVAO);
-    glDrawArrays(GL_POINTS, 0, sim.count);
+    glDrawArrays(GL_POINTS, first, splatCount);
+    glEndQuery(GL_TIME_ELAPSED);
+    if (persistentUpload)
+        regionFence[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
     // ---- Pass 2: Draw to screen ----
+    glBeginQuery(GL_TIME_ELAPSED, timerQueries[slot][1]);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glViewport(0, 0, width, height);
     glClearColor(0.05f, 0.05f, 0.08f, 1.0f);
@@ -234,6 +526,8 @@ void FluidRenderer::render(const SPHSimulation& sim) {
     // Background
     glUseProgram(bgProg);
     glUniform2f(bg_uRes, (float)width, (float)height);
+    glUniform2f(bg_uView, viewX, viewY);
+    glUniform4f(bg_uDomain, openEdge(d.x0), openEdge(d.y0), openEdge(d.x1), openEdge(d.y1));
     glUniform1f(bg_uWall, cfg::WALL_THICKNESS);
     glBindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
@@ -248,11 +542,31 @@ void FluidRenderer::render(const SPHSimulation& sim) {
     glUniform1i(fluid_uTex, 0);
     glUniform2f(fluid_uRes, (float)width, (float)height);
     glUniform1f(fluid_uThresh, cfg::THRESHOLD);
+    glUniform1i(fluid_uDivisor, splatDivisor);
 
     glBindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
     glDisable(GL_BLEND);
+    glEndQuery(GL_TIME_ELAPSED);
+    timerPending[slot] = true;
+}
+
+void FluidRenderer::readPixels(std::vector<unsigned char>& rgb) const {
+    std::vector<unsigned char> rgba((size_t)width * height * 4);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+
+    rgb.resize((size_t)width * height * 3);
+    for (int y = 0; y < height; y++) {
+        const unsigned char* src = &rgba[(size_t)(height - 1 - y) * width * 4];
+        unsigned char*       dst = &rgb[(size_t)y * width * 3];
+        for (int x = 0; x < width; x++) {
+            dst[x * 3]     = src[x * 4];
+            dst[x * 3 + 1] = src[x * 4 + 1];
+            dst[x * 3 + 2] = src[x * 4 + 2];
+        }
+    }
 }
 
 // ---- Shader compilation ----
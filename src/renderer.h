@@ -2,37 +2,98 @@
 
 #include "gl_loader.h"
 #include "config.h"
+#include <vector>
 
 class SPHSimulation;   // forward decl
 
+// How particle positions reach the GPU each frame
+struct UploadOptions {
+    bool persistent   = true;    // persistently mapped ring if ARB_buffer_storage is available
+    bool splitStreams = false;   // posX and posY as two attributes, no interleave copy
+};
+
 class FluidRenderer {
 public:
-    FluidRenderer(int width, int height);
+    // splatDivisor > 1 splats into a target 1/splatDivisor the size of the
+    // screen (2 = half, 4 = quarter) and upsamples it in the fluid pass
+    FluidRenderer(int width, int height, int maxParticles = cfg::MAX_PARTICLES,
+                  UploadOptions upload = UploadOptions(), int splatDivisor = 1);
     ~FluidRenderer();
     void render(const SPHSimulation& sim);
 
+    // Copy the default framebuffer as 8-bit RGB, top row first
+    void readPixels(std::vector<unsigned char>& rgb) const;
+
+    // Simulation coordinates at the window's top-left corner; move it to
+    // follow fluid in a domain larger than the window
+    float viewX = 0.0f, viewY = 0.0f;
+
+    // Splat only sim.onSurface particles and stand in for the rest with a
+    // coarse density layer drawn into the splat target as one quad
+    bool cullInterior = false;
+    int  splatCount   = 0;       // particles splatted last frame
+
+    // True when positions are written straight into a mapped buffer;
+    // false when falling back to orphaning with glBufferData
+    bool persistentUpload = false;
+
+    // GPU time of each pass in ms, read back from timer queries issued
+    // QUERY_FRAMES frames earlier so the CPU never waits on the GPU
+    float splatMs     = 0.0f;
+    float compositeMs = 0.0f;
+    float uploadMs    = 0.0f;    // CPU time to hand positions to GL, fence waits included
+
 private:
+    static constexpr int QUERY_FRAMES = 3;
+    static constexpr int UPLOAD_REGIONS = 3;
     int width, height;
+    int capacity;
+    UploadOptions upload;
 
     // Shader programs
-    GLuint splatProg, fluidProg, bgProg;
+    GLuint splatProg, fluidProg, bgProg, interiorProg;
 
     // Geometry
     GLuint particleVAO, particleVBO;
     GLuint quadVAO, quadVBO;
 
-    // Framebuffer for the splat pass
+    // Framebuffer for the splat pass: single-channel R16F density
     GLuint splatFBO, splatTex;
+    int    splatDivisor, splatW, splatH;
+
+    // Timer queries: [frame slot][0 = splat, 1 = composite]
+    GLuint timerQueries[QUERY_FRAMES][2];
+    bool   timerPending[QUERY_FRAMES] = {};
+    int    timerFrame = 0;
+
+    // Persistent upload: the VBO holds UPLOAD_REGIONS regions of `capacity`
+    // vertices, all posX regions first and then all posY regions when the
+    // streams are split. Frame k writes region k % UPLOAD_REGIONS and draws
+    // from its first vertex, so attribute pointers never change.
+    float* mapped = nullptr;
+    GLsync regionFence[UPLOAD_REGIONS] = {};
+    int    region = 0;
+
+    // Orphaning fallback: interleave buffer for the packed layout
+    std::vector<float> posData;
 
-    // Temp buffer for uploading positions
-    float posData[cfg::MAX_PARTICLES * 2];
+    // Positions gathered for upload when clipping to the view or culling
+    // the interior, and the interior particles' splats on INTERIOR_CELL texels
+    std::vector<float> surfX, surfY;
+    std::vector<float> interiorData;
+    GLuint interiorTex;
+    int    interiorW, interiorH;
 
     // Uniform locations
-    GLint splat_uRes, splat_uPtSize;
-    GLint fluid_uTex, fluid_uRes, fluid_uThresh;
-    GLint bg_uRes, bg_uWall;
+    GLint splat_uRes, splat_uView, splat_uPtSize;
+    GLint fluid_uTex, fluid_uRes, fluid_uThresh, fluid_uDivisor;
+    GLint bg_uRes, bg_uView, bg_uDomain, bg_uWall;
+    GLint interior_uTex, interior_uScale;
 
     GLuint compileProgram(const char* vsSrc, const char* fsSrc);
     void   setupGeometry();
+    int    uploadPositions(const SPHSimulation& sim);
+    void   gatherSplats(const SPHSimulation& sim, bool clip);
     void   setupFBO();
+    void   readTimers(int slot);
 };
@@ -0,0 +1,148 @@
+#include "replay.h"
+#include "simulation.h"
+#include <cstring>
+#include <string>
+
+static const char MAGIC[] = "LQREPLAY2\n";
+static const char OLD_MAGIC[] = "LQREPLAY1\n";
+
+enum : uint8_t {
+    MOUSE_DOWN      = 1,
+    POUR            = 2,
+    RESET           = 4,
+    TOGGLE_ADAPTIVE = 8,
+    CURSOR          = 16,
+};
+
+// Bits of the settings word in the header
+static constexpr uint32_t SETTING_COMPACT_FORCES = 1;
+
+void stepFrame(SPHSimulation& sim, const FrameInput& in) {
+    if (in.reset) sim.initScene();
+    if (in.toggleAdaptive) sim.adaptive = !sim.adaptive;
+    if (in.pour) sim.pour(in.mouseX, in.mouseY);
+    sim.applyMouseForce(in.mouseX, in.mouseY, in.mouseDown);
+    sim.update();
+}
+
+// ---- Recording ----
+
+InputRecorder::~InputRecorder() {
+    close();
+}
+
+bool InputRecorder::open(const char* path, const Scenario& scenario, bool compactForces) {
+    close();
+    file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Cannot write input log: %s\n", path);
+        return false;
+    }
+
+    std::string text = formatScenario(scenario);
+    uint32_t settings = compactForces ? SETTING_COMPACT_FORCES : 0;
+    uint32_t length = (uint32_t)text.size();
+    fwrite(MAGIC, 1, sizeof(MAGIC) - 1, file);
+    fwrite(&settings, sizeof(settings), 1, file);
+    fwrite(&length, sizeof(length), 1, file);
+    fwrite(text.data(), 1, text.size(), file);
+    frames = 0;
+    haveCursor = false;
+    return true;
+}
+
+void InputRecorder::record(const FrameInput& in, const SPHSimulation& sim) {
+    if (!file) return;
+
+    uint8_t flags = (in.mouseDown ? MOUSE_DOWN : 0) | (in.pour ? POUR : 0) |
+                    (in.reset ? RESET : 0) | (in.toggleAdaptive ? TOGGLE_ADAPTIVE : 0);
+    bool usesCursor = in.mouseDown || in.pour;
+    if (usesCursor && (!haveCursor || in.mouseX != lastX || in.mouseY != lastY)) {
+        flags |= CURSOR;
+        lastX = in.mouseX;
+        lastY = in.mouseY;
+        haveCursor = true;
+    }
+
+    uint32_t hash = (uint32_t)sim.stateHash();
+    fwrite(&flags, 1, 1, file);
+    if (flags & CURSOR) {
+        fwrite(&lastX, sizeof(float), 1, file);
+        fwrite(&lastY, sizeof(float), 1, file);
+    }
+    fwrite(&hash, sizeof(hash), 1, file);
+    frames++;
+}
+
+void InputRecorder::close() {
+    if (!file) return;
+    fclose(file);
+    file = nullptr;
+}
+
+// ---- Playback ----
+
+bool InputLog::load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Cannot open input log: %s\n", path);
+        return false;
+    }
+
+    char magic[sizeof(MAGIC) - 1];
+    uint32_t settings = 0, length = 0;
+    if (fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+        std::memcmp(magic, OLD_MAGIC, sizeof(magic)) == 0) {
+        // Version 1 did not record the force pass, so it cannot be replayed reliably
+        fprintf(stderr, "Input log from an older version, record it again: %s\n", path);
+        fclose(f);
+        return false;
+    }
+    if (std::memcmp(magic, MAGIC, sizeof(magic)) != 0 ||
+        fread(&settings, sizeof(settings), 1, f) != 1 ||
+        fread(&length, sizeof(length), 1, f) != 1) {
+        fprintf(stderr, "Not an input log: %s\n", path);
+        fclose(f);
+        return false;
+    }
+    compactForces = (settings & SETTING_COMPACT_FORCES) != 0;
+
+    std::string text(length, '\0');
+    if (fread(&text[0], 1, length, f) != length) {
+        fprintf(stderr, "Truncated input log: %s\n", path);
+        fclose(f);
+        return false;
+    }
+    scenario = Scenario();
+    if (!parseScenario(text, path, scenario)) {
+        fclose(f);
+        return false;
+    }
+
+    frames.clear();
+    hashes.clear();
+    FrameInput in;
+    uint8_t flags;
+    while (fread(&flags, 1, 1, f) == 1) {
+        in.mouseDown      = (flags & MOUSE_DOWN) != 0;
+        in.pour           = (flags & POUR) != 0;
+        in.reset          = (flags & RESET) != 0;
+        in.toggleAdaptive = (flags & TOGGLE_ADAPTIVE) != 0;
+
+        uint32_t hash;
+        bool ok = true;
+        if (flags & CURSOR)
+            ok = fread(&in.mouseX, sizeof(float), 1, f) == 1 &&
+                 fread(&in.mouseY, sizeof(float), 1, f) == 1;
+        ok = ok && fread(&hash, sizeof(hash), 1, f) == 1;
+        if (!ok) {
+            // A session killed mid-write leaves a partial last record
+            fprintf(stderr, "Input log ends mid-frame after %zu frames: %s\n", frames.size(), path);
+            break;
+        }
+        frames.push_back(in);
+        hashes.push_back(hash);
+    }
+    fclose(f);
+    return true;
+}
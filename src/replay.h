@@ -0,0 +1,58 @@
+#pragma once
+
+#include "scenario.h"
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+class SPHSimulation;   // forward decl
+
+// Everything the main loop feeds the simulation in one frame
+struct FrameInput {
+    float mouseX = 0.0f, mouseY = 0.0f;
+    bool  mouseDown      = false;
+    bool  pour           = false;   // F held
+    bool  reset          = false;   // R held
+    bool  toggleAdaptive = false;   // A went down this frame
+};
+
+// Apply one frame's input, then advance the simulation one frame. The live
+// loop and replay both step through here, so they do exactly the same work.
+void stepFrame(SPHSimulation& sim, const FrameInput& in);
+
+// Input log, native byte order:
+//   "LQREPLAY2\n", u32 settings: 1 compact forces
+//   u32 length, scenario text (formatScenario)
+//   then one record per frame:
+//     u8  flags: 1 mouse down, 2 pour, 4 reset, 8 toggle adaptive, 16 cursor moved
+//     f32 x, f32 y     cursor, only with flag 16
+//     u32 low half of sim.stateHash() after the frame
+// The cursor is written only when a push or pour uses it and it has moved
+// since it was last written, so an idle frame costs five bytes.
+class InputRecorder {
+public:
+    InputRecorder() = default;
+    ~InputRecorder();
+
+    bool open(const char* path, const Scenario& scenario, bool compactForces);
+    void record(const FrameInput& in, const SPHSimulation& sim);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    uint64_t frames = 0;
+
+private:
+    FILE* file = nullptr;
+    bool  haveCursor = false;
+    float lastX = 0.0f, lastY = 0.0f;
+};
+
+// A whole log read back for replay
+struct InputLog {
+    Scenario scenario;
+    bool compactForces = false;       // force pass the session ran with
+    std::vector<FrameInput> frames;
+    std::vector<uint32_t>   hashes;   // expected state after each frame
+
+    bool load(const char* path);
+};
@@ -0,0 +1,253 @@
+#include "scenario.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+
+// ---- Key/value parsing ----
+
+static bool parseFloats(const char* value, float* out, int n) {
+    // Accept both "1 2 3" (files) and "1,2,3" (command line)
+    std::string s(value);
+    for (char& c : s) if (c == ',') c = ' ';
+
+    const char* p = s.c_str();
+    for (int k = 0; k < n; k++) {
+        char* end;
+        out[k] = strtof(p, &end);
+        if (end == p) return false;
+        p = end;
+    }
+    while (*p == ' ' || *p == '\t') p++;
+    return *p == '\0';
+}
+
+// n required values followed by an optional period (0 if absent)
+static bool parseWithPeriod(const char* value, float* out, int n) {
+    out[n] = 0.0f;
+    return parseFloats(value, out, n + 1) || parseFloats(value, out, n);
+}
+
+static bool parseInt(const char* value, int& out) {
+    char* end;
+    long v = strtol(value, &end, 10);
+    while (*end == ' ' || *end == '\t') end++;
+    if (end == value || *end != '\0') return false;
+    out = (int)v;
+    return true;
+}
+
+static bool setValue(const std::string& key, const char* value, Scenario& sc) {
+    struct FloatKey { const char* name; float Scenario::* field; };
+    static const FloatKey floatKeys[] = {
+        { "smoothing_radius", &Scenario::smoothingRadius },
+        { "particle_mass",    &Scenario::particleMass },
+        { "stiffness",        &Scenario::stiffness },
+        { "viscosity",        &Scenario::viscosity },
+        { "gravity",          &Scenario::gravity },
+        { "dt",               &Scenario::dt },
+    };
+    struct IntKey { const char* name; int Scenario::* field; };
+    static const IntKey intKeys[] = {
+        { "width",         &Scenario::width },
+        { "height",        &Scenario::height },
+        { "max_particles", &Scenario::maxParticles },
+        { "substeps",      &Scenario::substeps },
+        { "seed",          &Scenario::seed },
+    };
+
+    for (const FloatKey& k : floatKeys)
+        if (key == k.name) return parseFloats(value, &(sc.*k.field), 1);
+    for (const IntKey& k : intKeys)
+        if (key == k.name) return parseInt(value, sc.*k.field);
+
+    if (key == "block") {
+        float v[4];
+        if (!parseFloats(value, v, 4)) return false;
+        sc.blocks.push_back({ v[0], v[1], v[2], v[3] });
+        return true;
+    }
+    if (key == "circle") {
+        float v[3];
+        if (!parseFloats(value, v, 3)) return false;
+        sc.circles.push_back({ v[0], v[1], v[2] });
+        return true;
+    }
+    if (key == "domain") {
+        float v[4];
+        if (!parseFloats(value, v, 4) || !(v[0] < v[2]) || !(v[1] < v[3])) return false;
+        sc.domain = { v[0], v[1], v[2], v[3] };
+        return true;
+    }
+    if (key == "emitter") {
+        float v[5];
+        if (!parseFloats(value, v, 5)) return false;
+        sc.emitters.push_back({ v[0], v[1], v[2], v[3], v[4] });
+        return true;
+    }
+    if (key == "wind") {
+        float v[3];
+        if (!parseWithPeriod(value, v, 2)) return false;
+        sc.fields.push_back({ FieldSource::Wind, v[0], v[1], 0.0f, 0.0f, v[2] });
+        return true;
+    }
+    if (key == "vortex" || key == "attractor") {
+        float v[5];
+        if (!parseWithPeriod(value, v, 4)) return false;
+        FieldSource::Kind kind = key == "vortex" ? FieldSource::Vortex : FieldSource::Attractor;
+        sc.fields.push_back({ kind, v[0], v[1], v[2], v[3], v[4] });
+        return true;
+    }
+    return false;
+}
+
+static std::string trim(const std::string& s) {
+    size_t a = s.find_first_not_of(" \t\r\n");
+    if (a == std::string::npos) return "";
+    size_t b = s.find_last_not_of(" \t\r\n");
+    return s.substr(a, b - a + 1);
+}
+
+bool loadScenario(const char* path, Scenario& out) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Cannot open scenario file: %s\n", path);
+        return false;
+    }
+
+    std::string text;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, n);
+    fclose(f);
+    return parseScenario(text, path, out);
+}
+
+bool parseScenario(const std::string& text, const char* name, Scenario& out) {
+    int  lineNo = 0;
+    bool ok = true;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) end = text.size();
+        std::string s = text.substr(start, end - start);
+        start = end + 1;
+        lineNo++;
+
+        size_t hash = s.find('#');
+        if (hash != std::string::npos) s.erase(hash);
+        s = trim(s);
+        if (s.empty()) continue;
+
+        size_t eq = s.find('=');
+        if (eq == std::string::npos ||
+            !setValue(trim(s.substr(0, eq)), trim(s.substr(eq + 1)).c_str(), out)) {
+            fprintf(stderr, "%s:%d: invalid scenario line: %s\n", name, lineNo, s.c_str());
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+std::string formatScenario(const Scenario& sc) {
+    std::string out;
+    char line[256];
+    auto add = [&](const char* fmt, auto... v) {
+        snprintf(line, sizeof(line), fmt, v...);
+        out += line;
+    };
+
+    // %.9g round-trips every float exactly
+    add("width = %d\n", sc.width);
+    add("height = %d\n", sc.height);
+    add("max_particles = %d\n", sc.maxParticles);
+    add("smoothing_radius = %.9g\n", sc.smoothingRadius);
+    add("particle_mass = %.9g\n", sc.particleMass);
+    add("stiffness = %.9g\n", sc.stiffness);
+    add("viscosity = %.9g\n", sc.viscosity);
+    add("gravity = %.9g\n", sc.gravity);
+    add("dt = %.9g\n", sc.dt);
+    add("substeps = %d\n", sc.substeps);
+    add("seed = %d\n", sc.seed);
+    if (sc.domain.x1 > sc.domain.x0)
+        add("domain = %.9g %.9g %.9g %.9g\n", sc.domain.x0, sc.domain.y0, sc.domain.x1, sc.domain.y1);
+    for (const Scenario::Block& b : sc.blocks)
+        add("block = %.9g %.9g %.9g %.9g\n", b.x0, b.y0, b.x1, b.y1);
+    for (const Scenario::Circle& c : sc.circles)
+        add("circle = %.9g %.9g %.9g\n", c.x, c.y, c.radius);
+    for (const Scenario::Emitter& e : sc.emitters)
+        add("emitter = %.9g %.9g %.9g %.9g %.9g\n", e.x, e.y, e.vx, e.vy, e.rate);
+    for (const FieldSource& f : sc.fields) {
+        if (f.kind == FieldSource::Wind)
+            add("wind = %.9g %.9g %.9g\n", f.x, f.y, f.period);
+        else
+            add("%s = %.9g %.9g %.9g %.9g %.9g\n", f.kind == FieldSource::Vortex ? "vortex" : "attractor",
+                f.x, f.y, f.strength, f.radius, f.period);
+    }
+    return out;
+}
+
+Scenario::Block Scenario::bounds() const {
+    if (domain.x1 > domain.x0) return domain;
+    return { 0.0f, 0.0f, (float)width, (float)height };
+}
+
+bool applyScenarioOption(const char* arg, Scenario& out) {
+    if (std::strncmp(arg, "--", 2) != 0) return false;
+    const char* eq = std::strchr(arg, '=');
+    if (!eq) return false;
+    return setValue(std::string(arg + 2, eq), eq + 1, out);
+}
+
+// Comparisons are written so NaN fails them: `!(x > 0)` rather than
+// `x <= 0`, and anything that must be a number is checked with isfinite
+static bool finite(std::initializer_list<float> values) {
+    for (float v : values)
+        if (!std::isfinite(v)) return false;
+    return true;
+}
+
+bool validateScenario(const Scenario& sc) {
+    const char* err = nullptr;
+    if (sc.width <= 0 || sc.height <= 0)      err = "domain size must be positive";
+    else if (sc.maxParticles <= 0)            err = "max_particles must be positive";
+    else if (!(sc.smoothingRadius > 0.0f) || !finite({ sc.smoothingRadius }))
+                                              err = "smoothing_radius must be a positive number";
+    else if (!(sc.particleMass > 0.0f) || !finite({ sc.particleMass }))
+                                              err = "particle_mass must be a positive number";
+    else if (!(sc.dt > 0.0f) || !finite({ sc.dt }))
+                                              err = "dt must be a positive number";
+    else if (sc.substeps <= 0)                err = "substeps must be positive";
+    else if (!finite({ sc.stiffness }))       err = "stiffness must be a number";
+    else if (!finite({ sc.viscosity }))       err = "viscosity must be a number";
+    else if (!finite({ sc.gravity }))         err = "gravity must be a number";
+
+    // Walls sit BOUND_PAD inside the domain edges. Sides may be infinite
+    // (open), but not NaN.
+    Scenario::Block d = sc.bounds();
+    float minSpan = 4.0f * cfg::BOUND_PAD;
+    if (!err && !(d.x1 - d.x0 > minSpan && d.y1 - d.y0 > minSpan)) err = "domain is too small";
+
+    for (const Scenario::Block& b : sc.blocks)
+        if (!err && !finite({ b.x0, b.y0, b.x1, b.y1 })) err = "block corners must be numbers";
+    for (const Scenario::Circle& c : sc.circles)
+        if (!err && (!(c.radius > 0.0f) || !finite({ c.x, c.y, c.radius })))
+            err = "circle needs a finite centre and a positive radius";
+    for (const Scenario::Emitter& e : sc.emitters) {
+        if (!err && !finite({ e.x, e.y, e.vx, e.vy, e.rate })) err = "emitter values must be numbers";
+        if (!err && !(e.rate >= 0.0f)) err = "emitter rate must not be negative";
+    }
+    for (const FieldSource& f : sc.fields) {
+        if (!err && !finite({ f.x, f.y, f.strength, f.radius, f.period })) err = "field values must be numbers";
+        if (!err && f.kind != FieldSource::Wind && !(f.radius > 0.0f)) err = "field radius must be positive";
+        if (!err && !(f.period >= 0.0f)) err = "field period must not be negative";
+    }
+
+    if (err) {
+        fprintf(stderr, "Invalid scenario: %s\n", err);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "config.h"
+#include "force_field.h"
+#include <string>
+#include <vector>
+
+// A run-time scene description. Every field defaults to its compile-time
+// value in config.h, so an empty scenario reproduces the built-in dam break.
+struct Scenario {
+    // Rectangle filled with particles at reset
+    struct Block {
+        float x0, y0, x1, y1;
+    };
+
+    // Disc filled with particles at reset
+    struct Circle {
+        float x, y, radius;
+    };
+
+    // Continuous source: `rate` particles per second at (x, y) with velocity (vx, vy)
+    struct Emitter {
+        float x, y;
+        float vx, vy;
+        float rate;
+    };
+
+    int   width           = cfg::WIDTH;
+    int   height          = cfg::HEIGHT;
+    int   maxParticles    = cfg::MAX_PARTICLES;
+    float smoothingRadius = cfg::SMOOTHING_RADIUS;
+    float particleMass    = cfg::PARTICLE_MASS;
+    float stiffness       = cfg::STIFFNESS;
+    float viscosity       = cfg::VISCOSITY;
+    float gravity         = cfg::GRAVITY;
+    float dt              = cfg::DT;
+    int   substeps        = cfg::SUBSTEPS;
+    int   seed            = 1;       // random jitter in fills, emitters and pours
+
+    // Walls around the simulated region. Unset (x1 <= x0) means the window,
+    // 0 0 width height; an edge at inf or -inf leaves that side open.
+    Block domain = { 0.0f, 0.0f, 0.0f, 0.0f };
+    Block bounds() const;
+
+    std::vector<Block>   blocks;     // no blocks or circles = default dam break
+    std::vector<Circle>  circles;
+    std::vector<Emitter> emitters;
+    std::vector<FieldSource> fields; // wind, vortices and attractors
+};
+
+// Load `key = value` lines from a scenario file ('#' starts a comment).
+// Keys match the command-line options below. Prints the offending line
+// and returns false on error.
+bool loadScenario(const char* path, Scenario& out);
+
+// Same, from text already in memory; `name` prefixes error messages
+bool parseScenario(const std::string& text, const char* name, Scenario& out);
+
+// Write every setting back out in the file format, floats exactly, so
+// parseScenario reproduces the scenario bit for bit
+std::string formatScenario(const Scenario& sc);
+
+// Apply one `--key=value` option, e.g. --smoothing_radius=12 or
+// --block=20,20,300,580. Returns false if `arg` is not a scenario option
+// or its value is invalid.
+bool applyScenarioOption(const char* arg, Scenario& out);
+
+// Reject scenarios the simulation cannot run (non-positive sizes etc.)
+bool validateScenario(const Scenario& sc);
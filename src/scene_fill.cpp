@@ -0,0 +1,141 @@
+#include "scene_fill.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// ---- Shapes ----
+
+FillShape FillShape::box(float x0, float y0, float x1, float y1) {
+    FillShape s;
+    s.kind = Box;
+    s.x0 = x0; s.y0 = y0; s.x1 = x1; s.y1 = y1;
+    return s;
+}
+
+FillShape FillShape::circle(float x, float y, float radius) {
+    FillShape s;
+    s.kind = Circle;
+    s.x0 = x - radius; s.y0 = y - radius;
+    s.x1 = x + radius; s.y1 = y + radius;
+    return s;
+}
+
+FillShape FillShape::custom(float x0, float y0, float x1, float y1,
+                            std::function<float(float, float)> sdf) {
+    FillShape s;
+    s.kind = Custom;
+    s.x0 = x0; s.y0 = y0; s.x1 = x1; s.y1 = y1;
+    s.sdf = std::move(sdf);
+    return s;
+}
+
+float FillShape::distance(float x, float y) const {
+    switch (kind) {
+        case Box: {
+            float dx = std::max(x0 - x, x - x1);
+            float dy = std::max(y0 - y, y - y1);
+            float ox = std::max(dx, 0.0f), oy = std::max(dy, 0.0f);
+            return sqrtf(ox * ox + oy * oy) + std::min(std::max(dx, dy), 0.0f);
+        }
+        case Circle: {
+            float r  = 0.5f * (x1 - x0);
+            float dx = x - (x0 + r), dy = y - (y0 + r);
+            return sqrtf(dx * dx + dy * dy) - r;
+        }
+        default:
+            return sdf ? sdf(x, y) : 1.0f;
+    }
+}
+
+// ---- Filling ----
+
+// Lattice points lo + k * step below hi
+int SceneFiller::steps(float lo, float hi, float step) {
+    if (!(hi > lo)) return 0;
+    int n = (int)ceilf((hi - lo) / step);
+    while (n > 0 && lo + (float)(n - 1) * step >= hi) n--;
+    while (lo + (float)n * step < hi) n++;
+    return n;
+}
+
+static inline uint32_t mix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+// Start of the jitter hash for one lattice row, shared by its points
+uint32_t SceneFiller::rowKey(int shapeIndex, int row) const {
+    return mix32(seed * 0x9E3779B9u ^ (uint32_t)shapeIndex * 0x85EBCA6Bu ^ (uint32_t)row * 0xC2B2AE35u);
+}
+
+// The pool is started on first use and restarted if `threads` changes
+WorkerPool& SceneFiller::workers() {
+    int wanted = threads > 0 ? threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    if (!pool || pool->size() != wanted) pool.reset(new WorkerPool(wanted));
+    return *pool;
+}
+
+// Run f(row) for every row, in small chunks on the pool when the fill is
+// big enough to repay waking it
+template <class F>
+void SceneFiller::forEachRow(int rows, long points, F&& f) {
+    constexpr int  CHUNK = 8;
+    constexpr long PARALLEL_POINTS = 32768;
+
+    if (points < PARALLEL_POINTS) {
+        for (int r = 0; r < rows; r++) f(r);
+        return;
+    }
+    forEachChunk(rows, CHUNK, [&](int r0, int r1) {
+        for (int r = r0; r < r1; r++) f(r);
+    });
+}
+
+// Two passes over the rows: count the points inside the shape, then write
+// them, so each row knows where its particles go without any locking.
+int SceneFiller::fill(const FillShape& shape, int shapeIndex, float* xs, float* ys, int first, int capacity) {
+    const int rows = steps(shape.y0, shape.y1, spacing);
+    const int cols = steps(shape.x0, shape.x1, spacing);
+    if (rows == 0 || cols == 0 || first >= capacity) return first;
+
+    const bool box    = shape.kind == FillShape::Box;
+    const long points = (long)rows * cols;
+
+    rowStart.assign(rows + 1, 0);
+    if (box) {
+        for (int r = 0; r < rows; r++) rowStart[r + 1] = cols;
+    } else {
+        forEachRow(rows, points, [&](int r) {
+            float y = shape.y0 + (float)r * spacing;
+            int n = 0;
+            for (int c = 0; c < cols; c++)
+                if (shape.distance(shape.x0 + (float)c * spacing, y) < 0.0f) n++;
+            rowStart[r + 1] = n;
+        });
+    }
+    rowStart[0] = first;
+    for (int r = 0; r < rows; r++) rowStart[r + 1] += rowStart[r];
+
+    forEachRow(rows, points, [&](int r) {
+        int n   = rowStart[r];
+        int end = std::min(rowStart[r + 1], capacity);
+        if (n >= end) return;
+
+        uint32_t key = rowKey(shapeIndex, r);
+        if (box) {
+            // Every column is inside: a straight run the compiler can vectorize
+            float y = shape.y0 + (float)r * spacing;
+            float* rx = xs + n;
+            float* ry = ys + n;
+            for (int c = 0; c < end - n; c++) place(key, c, shape.x0 + (float)c * spacing, y, rx[c], ry[c]);
+            return;
+        }
+        for (int c = 0; c < cols && n < end; c++)
+            if (point(shape, key, r, c, xs[n], ys[n])) n++;
+    });
+    return std::min(rowStart[rows], capacity);
+}
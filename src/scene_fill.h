@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include "worker_pool.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// A region filled with particles at reset, given by its signed distance:
+// negative inside, positive outside. Boxes and circles are built in; any
+// other shape can be passed as a distance function over its bounding box.
+struct FillShape {
+    enum Kind { Box, Circle, Custom };
+
+    Kind  kind = Box;
+    float x0 = 0.0f, y0 = 0.0f, x1 = 0.0f, y1 = 0.0f;   // bounding box
+    std::function<float(float, float)> sdf;              // Custom only
+
+    static FillShape box(float x0, float y0, float x1, float y1);
+    static FillShape circle(float x, float y, float radius);
+    static FillShape custom(float x0, float y0, float x1, float y1,
+                            std::function<float(float, float)> sdf);
+
+    float distance(float x, float y) const;
+};
+
+// Fills shapes on a square lattice anchored at each shape's top-left
+// corner, with a small random offset per particle. Lattice rows are split
+// between the threads of a pool that is started on the first big fill and
+// kept for later resets. Every point's jitter is a hash of (seed, shape, row,
+// column), so the particles and their order are the same for any number of
+// threads, and any point can be rebuilt on its own without the others.
+class SceneFiller {
+public:
+    float    spacing = 8.0f;    // lattice pitch, px
+    float    jitter  = 0.1f;    // offset range as a fraction of spacing
+    uint32_t seed    = 1;
+    int      threads = 0;       // 0 = one per core
+
+    // Positions are clamped into this rectangle, as addParticle does
+    float minX = 0.0f, minY = 0.0f, maxX = 0.0f, maxY = 0.0f;
+
+    // Write the lattice points inside `shape` to xs/ys from index `first`,
+    // stopping at `capacity`. `shapeIndex` picks the jitter. Returns the new
+    // particle count.
+    int fill(const FillShape& shape, int shapeIndex, float* xs, float* ys, int first, int capacity);
+
+    // Call f(px, py) with the position fill() gives each point of `shape`
+    // that can land within `radius` of (x, y), without filling anything.
+    // Points beyond a clamp edge all land on it, so a window that reaches an
+    // edge runs on to the end of the lattice. Callers test distances.
+    template <class F>
+    void forPointsNear(const FillShape& shape, int shapeIndex, float x, float y, float radius, F&& f) const;
+
+    // Run f(begin, end) over [0, n) in runs of `chunk` on the fill threads,
+    // so the rest of a reset scales with cores too. The runs do not depend
+    // on the thread count; a single run is done inline.
+    template <class F>
+    void forEachChunk(int n, int chunk, F&& f);
+
+private:
+    std::vector<int> rowStart;   // first particle of each row, then the total
+    std::unique_ptr<WorkerPool> pool;
+
+    static int steps(float lo, float hi, float step);
+    uint32_t rowKey(int shapeIndex, int row) const;
+    bool point(const FillShape& shape, uint32_t key, int row, int col, float& x, float& y) const;
+    void place(uint32_t key, int col, float lx, float ly, float& x, float& y) const;
+    WorkerPool& workers();
+
+    template <class F> void forEachRow(int rows, long points, F&& f);
+};
+
+template <class F>
+void SceneFiller::forEachChunk(int n, int chunk, F&& f) {
+    int runs = (n + chunk - 1) / chunk;
+    if (runs <= 1) {
+        if (n > 0) f(0, n);
+        return;
+    }
+    workers().forEach(runs, [&](int k) { f(k * chunk, std::min(n, (k + 1) * chunk)); });
+}
+
+template <class F>
+void SceneFiller::forPointsNear(const FillShape& shape, int shapeIndex, float x, float y, float radius, F&& f) const {
+    const int rows = steps(shape.y0, shape.y1, spacing);
+    const int cols = steps(shape.x0, shape.x1, spacing);
+    if (rows == 0 || cols == 0) return;
+
+    // Lattice indices whose jittered points can come within `reach` of
+    // `centre` on one axis
+    const float halfAmp = 0.5f * spacing * jitter;
+    auto range = [&](float centre, float reach, float origin, float lowEdge, float highEdge, int n,
+                     int& first, int& last) {
+        float lo = centre - reach <= lowEdge  ? 0.0f : floorf((centre - reach - origin) / spacing);
+        float hi = centre + reach >= highEdge ? (float)(n - 1) : ceilf((centre + reach - origin) / spacing);
+        first = (int)std::max(lo, 0.0f);
+        last  = (int)std::min(hi, (float)(n - 1));
+    };
+    int r0, r1;
+    range(y, radius + halfAmp, shape.y0, minY, maxY, rows, r0, r1);
+
+    // Rows no clamp can move in y only need the chord of the circle they cut
+    for (int r = r0; r <= r1; r++) {
+        float ly = shape.y0 + (float)r * spacing;
+        float reach = radius + halfAmp;
+        if (ly - halfAmp >= minY && ly + halfAmp <= maxY) {
+            float dy = fabsf(ly - y) - halfAmp;
+            if (dy >= radius) continue;
+            if (dy > 0.0f) reach = sqrtf(radius * radius - dy * dy) + halfAmp;
+        }
+        int c0, c1;
+        range(x, reach, shape.x0, minX, maxX, cols, c0, c1);
+
+        uint32_t key = rowKey(shapeIndex, r);
+        for (int c = c0; c <= c1; c++) {
+            float px, py;
+            if (point(shape, key, r, c, px, py)) f(px, py);
+        }
+    }
+}
+
+// Lattice point at (lx, ly), column `col` of the row hashed into `key`,
+// after jitter and clamping. One hash per point gives both offsets, 16 bits
+// each.
+inline void SceneFiller::place(uint32_t key, int col, float lx, float ly, float& x, float& y) const {
+    uint32_t h = key ^ (uint32_t)col * 0x27D4EB2Fu;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    float jx = (float)(h >> 16) * (1.0f / 65536.0f);
+    float jy = (float)(h & 0xFFFFu) * (1.0f / 65536.0f);
+    float amp = spacing * jitter;
+    x = std::min(std::max(lx + (jx - 0.5f) * amp, minX), maxX);
+    y = std::min(std::max(ly + (jy - 0.5f) * amp, minY), maxY);
+}
+
+// Position of lattice point (row, col) of `shape`, or false if the point
+// lies outside the shape. Boxes skip the distance test; every lattice point
+// in the box is inside.
+inline bool SceneFiller::point(const FillShape& shape, uint32_t key, int row, int col, float& x, float& y) const {
+    float lx = shape.x0 + (float)col * spacing;
+    float ly = shape.y0 + (float)row * spacing;
+    if (shape.kind != FillShape::Box && shape.distance(lx, ly) >= 0.0f) return false;
+    place(key, col, lx, ly, x, y);
+    return true;
+}
@@ -1,164 +1,739 @@
 #include "simulation.h"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
-#include <cstring>
 #include <cstdlib>
+#include <cstring>
+#include <type_traits>
 
 static constexpr float PI = 3.14159265358979323846f;
 
-SPHSimulation::SPHSimulation(int width, int height)
-    : width(width), height(height)
+using Clock = std::chrono::steady_clock;
+
+// IEEE half conversions for the packed neighbour state. Rebiasing by 2^112
+// in float arithmetic maps half subnormals and zero onto float values
+// directly, so only infinities and NaN (which velocities never reach) are
+// left unhandled.
+static inline uint16_t toHalf(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, 4);
+    uint32_t sign = (x >> 16) & 0x8000u;
+    float a = fminf(fabsf(f), 65504.0f) * 0x1p-112f;
+    std::memcpy(&x, &a, 4);
+    x += 0x0FFFu + ((x >> 13) & 1u);        // round to nearest even
+    return (uint16_t)(sign | (x >> 13));
+}
+
+static inline float fromHalf(uint16_t h) {
+    uint32_t x = (uint32_t)(h & 0x7FFFu) << 13;
+    float f;
+    std::memcpy(&f, &x, 4);
+    f *= 0x1p112f;
+    std::memcpy(&x, &f, 4);
+    x |= (uint32_t)(h & 0x8000u) << 16;     // sign as a bit, not a branch
+    std::memcpy(&f, &x, 4);
+    return f;
+}
+
+static double elapsedMs(Clock::time_point& since) {
+    Clock::time_point now = Clock::now();
+    double ms = std::chrono::duration<double, std::milli>(now - since).count();
+    since = now;
+    return ms;
+}
+
+SPHSimulation::SPHSimulation(const Scenario& scenario)
+    : bounds(scenario.bounds()), scene(scenario), width(scenario.width), height(scenario.height)
 {
-    h  = cfg::SMOOTHING_RADIUS;
-    h2 = h * h;
+    capacity  = scene.maxParticles;
+    stiffness = scene.stiffness;
+    viscosity = scene.viscosity;
+    gravity   = scene.gravity;
+
+    h = scene.smoothingRadius;
     cellSize = h;
 
-    poly6Coeff     =  4.0f  / (PI * powf(h, 8));
-    spikyGradCoeff = -30.0f / (PI * powf(h, 5));
-    viscLapCoeff   =  40.0f / (PI * powf(h, 5));
+    for (int l = 0; l <= cfg::MAX_LEVEL; l++) {
+        levelH[l]    = h * powf(sqrtf(2.0f), (float)l);
+        cellReach[l] = (int)ceilf(levelH[l] / cellSize - 1e-4f);
+    }
+
+    for (int a = 0; a <= cfg::MAX_LEVEL; a++) {
+        for (int b = 0; b <= cfg::MAX_LEVEL; b++) {
+            PairKernel& k = kernels[a][b];
+            k.h  = 0.5f * (levelH[a] + levelH[b]);
+            k.h2 = k.h * k.h;
+            k.poly6     =  4.0f  / (PI * powf(k.h, 8));
+            k.spikyGrad = -30.0f / (PI * powf(k.h, 5));
+            k.viscLap   =  40.0f / (PI * powf(k.h, 5));
+        }
+    }
 
-    std::memset(posX, 0, sizeof(posX));
-    std::memset(posY, 0, sizeof(posY));
-    std::memset(velX, 0, sizeof(velX));
-    std::memset(velY, 0, sizeof(velY));
+    posX.assign(capacity, 0.0f);
+    posY.assign(capacity, 0.0f);
+    velX.assign(capacity, 0.0f);
+    velY.assign(capacity, 0.0f);
+    density.assign(capacity, 0.0f);
+    onSurface.assign(capacity, 1);
+    pressure.assign(capacity, 0.0f);
+    forceX.assign(capacity, 0.0f);
+    forceY.assign(capacity, 0.0f);
+    mass.assign(capacity, 0.0f);
+    level.assign(capacity, 0);
+    depth.assign(capacity, 0.0f);
+    shear.assign(capacity, 0.0f);
+    emitAccum.assign(scene.emitters.size(), 0.0f);
+
+    field.sources = scene.fields;
+    field.fit(bounds.x0, bounds.y0, bounds.x1, bounds.y1, cfg::FIELD_CELL);
+}
+
+static Scenario defaultScenario(int width, int height) {
+    Scenario sc;
+    sc.width  = width;
+    sc.height = height;
+    return sc;
+}
+
+SPHSimulation::SPHSimulation(int width, int height)
+    : SPHSimulation(defaultScenario(width, height))
+{
 }
 
 void SPHSimulation::addParticle(float x, float y, float vx, float vy) {
-    if (count >= cfg::MAX_PARTICLES) return;
+    if (count >= capacity) return;
     const float pad = cfg::BOUND_PAD;
-    if (x < pad) x = pad;
-    if (x > width  - pad) x = (float)width  - pad;
-    if (y < pad) y = pad;
-    if (y > height - pad) y = (float)height - pad;
+    if (x < bounds.x0 + pad) x = bounds.x0 + pad;
+    if (x > bounds.x1 - pad) x = bounds.x1 - pad;
+    if (y < bounds.y0 + pad) y = bounds.y0 + pad;
+    if (y > bounds.y1 - pad) y = bounds.y1 - pad;
     int i = count++;
+    gridCurrent = false;
     posX[i] = x;  posY[i] = y;
     velX[i] = vx; velY[i] = vy;
+    mass[i]  = scene.particleMass;
+    level[i] = 0;
+    depth[i] = 0.0f;
+    shear[i] = 0.0f;
+    onSurface[i] = 1;
 }
 
-void SPHSimulation::initDamBreak() {
+// Draws go into locals first: argument evaluation order is unspecified, and
+// the sequence of draws is part of what makes a replay identical.
+void SPHSimulation::pour(float x, float y) {
+    for (int i = 0; i < 4 && count < capacity; i++) {
+        float jx = random(), jy = random(), jvx = random(), jvy = random();
+        addParticle(
+            x + (jx - 0.5f) * 10.0f,
+            y + (jy - 0.5f) * 10.0f,
+            (jvx - 0.5f) * 50.0f,
+            200.0f + jvy * 100.0f
+        );
+    }
+}
+
+// xorshift32: plenty for placement jitter, and identical on every platform
+float SPHSimulation::random() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return (float)(rngState >> 8) * (1.0f / 16777216.0f);
+}
+
+uint64_t SPHSimulation::stateHash() const {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&](const std::vector<float>& v) {
+        const unsigned char* p = (const unsigned char*)v.data();
+        for (size_t k = 0; k < (size_t)count * sizeof(float); k++) {
+            hash ^= p[k];
+            hash *= 1099511628211ull;
+        }
+    };
+    mix(posX);
+    mix(posY);
+    mix(velX);
+    mix(velY);
+    return hash;
+}
+
+// Common start of every reset: no particles, clock at zero, generator
+// back at the scenario seed
+void SPHSimulation::beginScene() {
     count = 0;
+    time  = 0.0f;
+    gridCurrent = false;
+    rngState = (uint32_t)scene.seed * 2654435761u;
+    if (rngState == 0) rngState = 0x9E3779B9u;
+    for (float& a : emitAccum) a = 0.0f;
+}
+
+// Fill the shapes in parallel straight into the particle arrays. Positions
+// get the same clamp and jitter range addParticle and the old serial fill
+// gave them; the jitter comes from the filler's per-point hash rather than
+// the simulation's generator.
+void SPHSimulation::fillShapes(const std::vector<FillShape>& shapes) {
+    const float pad = cfg::BOUND_PAD;
+    filler.spacing = h * 0.5f;
+    filler.seed = (uint32_t)scene.seed;
+    filler.minX = bounds.x0 + pad;
+    filler.minY = bounds.y0 + pad;
+    filler.maxX = bounds.x1 - pad;
+    filler.maxY = bounds.y1 - pad;
+
+    int first = count;
+    for (size_t k = 0; k < shapes.size(); k++)
+        count = filler.fill(shapes[k], (int)k, posX.data(), posY.data(), count, capacity);
+
+    // The other attributes in runs on the fill threads
+    constexpr int CHUNK = 16384;
+    filler.forEachChunk(count - first, CHUNK, [&](int begin, int end) {
+        int a = first + begin, b = first + end;
+        std::fill(velX.begin() + a, velX.begin() + b, 0.0f);
+        std::fill(velY.begin() + a, velY.begin() + b, 0.0f);
+        std::fill(mass.begin() + a, mass.begin() + b, scene.particleMass);
+        std::fill(level.begin() + a, level.begin() + b, (unsigned char)0);
+        std::fill(depth.begin() + a, depth.begin() + b, 0.0f);
+        std::fill(shear.begin() + a, shear.begin() + b, 0.0f);
+        std::fill(onSurface.begin() + a, onSurface.begin() + b, (unsigned char)1);
+    });
+    gridCurrent = false;
+}
+
+// Rest density is the mean density of the initial packing, scaled down so
+// settled particles always generate positive pressure and repel each other.
+// Large scenes average over a pseudo-random sample of particles instead of
+// every one. Past LATTICE_MIN particles each sample's neighbours are rebuilt
+// from the fill lattice around it, so the reset does not wait on a full grid
+// build (about 12 ns a particle against 0.4 us a sample); the first substep
+// builds the grid as usual. Smaller scenes, and fills cut short at capacity
+// (their lattice has holes), sample the grid, which the first substep reuses.
+void SPHSimulation::computeRestDensity(const std::vector<FillShape>& shapes) {
+    constexpr int LATTICE_MIN = 32 * cfg::REST_DENSITY_SAMPLES;
+    if (count == 0) return;
+
+    const bool lattice = count >= LATTICE_MIN && count < capacity;
+    if (!lattice) buildGrid();
+
+    // Samples are split between the fill threads; their densities are
+    // summed in sample order afterwards, so the result is the same for any
+    // number of threads
+    const PairKernel& k = kernels[0][0];   // every particle starts at level 0
+    const int samples = count < cfg::REST_DENSITY_SAMPLES ? count : cfg::REST_DENSITY_SAMPLES;
+    std::vector<float> sampleDensity(samples);
+    filler.forEachChunk(samples, 256, [&](int begin, int end) {
+        for (int s = begin; s < end; s++) {
+            int i = samples == count ? s : (int)(((uint32_t)s * 2654435761u) % (uint32_t)count);
+            float px = posX[i], py = posY[i];
+            float rho = 0.0f;
+            auto add = [&](float x, float y, float m) {
+                float diffX = px - x;
+                float diffY = py - y;
+                float r2 = diffX * diffX + diffY * diffY;
+                if (r2 < k.h2) {
+                    float w = k.h2 - r2;
+                    rho += m * k.poly6 * w * w * w;
+                }
+            };
+            if (lattice) {
+                for (size_t n = 0; n < shapes.size(); n++)
+                    filler.forPointsNear(shapes[n], (int)n, px, py, k.h,
+                                         [&](float x, float y) { add(x, y, scene.particleMass); });
+            } else {
+                forNeighbourCells(i, cellReach[0], [&](const Cell& c) {
+                    for (int n = c.first; n < c.first + c.count; n++) {
+                        int j = cellParticles[n];
+                        add(posX[j], posY[j], mass[j]);
+                    }
+                });
+            }
+            sampleDensity[s] = rho;
+        }
+    });
+
+    double total = 0.0;
+    for (float rho : sampleDensity) total += rho;
+    restDensity = (float)(total / samples) * 0.97f;
+}
+
+void SPHSimulation::initDamBreak() {
+    beginScene();
     float spacing = h * 0.5f;
     float startX = spacing * 2.0f;
     float startY = spacing * 2.0f;
     float blockW = width * 0.3f;
     float blockH = (float)height - spacing * 4.0f;
 
-    for (float y = startY; y < startY + blockH; y += spacing) {
-        for (float x = startX; x < startX + blockW; x += spacing) {
+    std::vector<FillShape> shapes = { FillShape::box(startX, startY, startX + blockW, startY + blockH) };
+    fillShapes(shapes);
+    computeRestDensity(shapes);
+}
+
+void SPHSimulation::initScene() {
+    if (scene.blocks.empty() && scene.circles.empty()) {
+        initDamBreak();
+        return;
+    }
+
+    beginScene();
+    std::vector<FillShape> shapes;
+    for (const Scenario::Block& b : scene.blocks)
+        shapes.push_back(FillShape::box(b.x0, b.y0, b.x1, b.y1));
+    for (const Scenario::Circle& c : scene.circles)
+        shapes.push_back(FillShape::circle(c.x, c.y, c.radius));
+    fillShapes(shapes);
+    computeRestDensity(shapes);
+}
+
+void SPHSimulation::updateEmitters() {
+    for (size_t e = 0; e < scene.emitters.size(); e++) {
+        const Scenario::Emitter& em = scene.emitters[e];
+        emitAccum[e] += em.rate * scene.dt;
+        while (emitAccum[e] >= 1.0f && count < capacity) {
+            emitAccum[e] -= 1.0f;
+            float jx = random(), jy = random();
             addParticle(
-                x + ((rand() / (float)RAND_MAX) - 0.5f) * spacing * 0.1f,
-                y + ((rand() / (float)RAND_MAX) - 0.5f) * spacing * 0.1f
+                em.x + (jx - 0.5f) * h * 0.5f,
+                em.y + (jy - 0.5f) * h * 0.5f,
+                em.vx, em.vy
             );
         }
+        // Don't bank particles that had no room; a full tank would otherwise
+        // burst them all out the moment space frees up.
+        if (count >= capacity) emitAccum[e] = 0.0f;
     }
+}
 
-    // Compute rest density from initial packed configuration,
-    // then scale down so settled particles always generate positive
-    // pressure and repel each other.
-    buildGrid();
-    computeDensityPressure();
-    float total = 0.0f;
-    for (int i = 0; i < count; i++) total += density[i];
-    restDensity = (total / (float)count) * 0.97f;
+// ---- Kernel policies ----
+
+struct SPHSimulation::TableKernel {
+    const SPHSimulation& sim;
+
+    const PairKernel& pair(int li, int lj) const { return sim.kernels[li][lj]; }
+    int reach(int i) const { return sim.searchReach(i); }
+    int reach(const Cell& c) const { return sim.cellReach[c.reachLevel]; }   // any particle in c
+};
+
+template <int H>
+struct SPHSimulation::FixedKernel {
+    static constexpr float r  = (float)H;
+    static constexpr float r5 = r * r * r * r * r;
+    static constexpr PairKernel k = {
+        r, r * r,
+         4.0f  / (PI * r5 * r * r * r),
+        -30.0f / (PI * r5),
+         40.0f / (PI * r5),
+    };
+
+    const PairKernel& pair(int, int) const { return k; }
+    int reach(int) const { return 1; }
+    int reach(const Cell&) const { return 1; }
+};
+
+// Run f with the fastest kernel policy valid for the current particles.
+// The fixed radii cover the configurations we actually ship and tune with.
+template <class F>
+void SPHSimulation::withKernel(F&& f) {
+    bool uniform = true;
+    for (int i = 0; i < count && uniform; i++) uniform = level[i] == 0;
+
+    if (uniform) {
+        if (h == 12.0f) return f(FixedKernel<12>{});
+        if (h == 16.0f) return f(FixedKernel<16>{});
+        if (h == 20.0f) return f(FixedKernel<20>{});
+        if (h == 24.0f) return f(FixedKernel<24>{});
+    }
+    f(TableKernel{ *this });
+}
+
+// ---- Sparse grid ----
+
+static uint64_t tileKey(int tx, int ty) {
+    return ((uint64_t)(uint32_t)tx << 32) | (uint32_t)ty;
 }
 
-// ---- Spatial hash ----
+int SPHSimulation::findTile(int tx, int ty) const {
+    auto it = tileSlots.find(tileKey(tx, ty));
+    return it == tileSlots.end() ? -1 : it->second;
+}
 
-int SPHSimulation::cellKey(int cx, int cy) const {
-    return (cx * 73856093) ^ (cy * 19349663);
+// Take a tile from the pool and link it to whichever neighbours exist
+int SPHSimulation::acquireTile(int tx, int ty) {
+    int t;
+    if (!freeTiles.empty()) {
+        t = freeTiles.back();
+        freeTiles.pop_back();
+    } else {
+        t = (int)tiles.size();
+        tiles.emplace_back();
+    }
+    tileSlots[tileKey(tx, ty)] = t;
+
+    Tile& tile = tiles[t];
+    tile.tx = tx;
+    tile.ty = ty;
+    tile.live = true;
+    tile.population = 0;
+    for (Cell& c : tile.cells) c = Cell();
+    for (int oy = -1; oy <= 1; oy++) {
+        for (int ox = -1; ox <= 1; ox++) {
+            int n = (ox == 0 && oy == 0) ? t : findTile(tx + ox, ty + oy);
+            tile.link[(oy + 1) * 3 + ox + 1] = n;
+            if (n >= 0) tiles[n].link[(1 - oy) * 3 + 1 - ox] = t;
+        }
+    }
+    return t;
 }
 
+void SPHSimulation::releaseTile(int t) {
+    Tile& tile = tiles[t];
+    for (int k = 0; k < 9; k++) {
+        int n = tile.link[k];
+        if (n >= 0 && n != t) tiles[n].link[8 - k] = -1;
+    }
+    tileSlots.erase(tileKey(tile.tx, tile.ty));
+    tile.live = false;
+    freeTiles.push_back(t);
+}
+
+SPHSimulation::Cell* SPHSimulation::cellNear(int t, int lx, int ly) {
+    int ox = lx < 0 ? -1 : (lx >= TILE ? 1 : 0);
+    int oy = ly < 0 ? -1 : (ly >= TILE ? 1 : 0);
+    int n = tiles[t].link[(oy + 1) * 3 + ox + 1];
+    if (n < 0) return nullptr;
+    return &tiles[n].cells[(ly - oy * TILE) * TILE + lx - ox * TILE];
+}
+
+const SPHSimulation::Cell* SPHSimulation::cellNear(int t, int lx, int ly) const {
+    return const_cast<SPHSimulation*>(this)->cellNear(t, lx, ly);
+}
+
+const SPHSimulation::Cell* SPHSimulation::cellAt(int cx, int cy) const {
+    int t = findTile(cx >> TILE_SHIFT, cy >> TILE_SHIFT);
+    if (t < 0) return nullptr;
+    return &tiles[t].cells[(cy & (TILE - 1)) * TILE + (cx & (TILE - 1))];
+}
+
+const SPHSimulation::Cell& SPHSimulation::homeCell(int i) const {
+    int pc = particleCell[i];
+    return tiles[pc / TILE_CELLS].cells[pc % TILE_CELLS];
+}
+
+// Cells are filled in index order, so each cell lists its particles in the
+// same order as the particle arrays.
 void SPHSimulation::buildGrid() {
-    grid.clear();
+    gridCurrent = true;
+    for (Tile& tile : tiles) {
+        if (!tile.live) continue;
+        tile.population = 0;
+        for (Cell& c : tile.cells) c = Cell();
+    }
+
+    // Home cell of every particle, taking tiles as fluid moves into them.
+    // Neighbouring particles mostly share a tile, so the last one is cached.
+    particleCell.resize(count);
+    int lastTile = -1, lastTx = 0, lastTy = 0;
     for (int i = 0; i < count; i++) {
-        int cx = (int)(posX[i] / cellSize);
-        int cy = (int)(posY[i] / cellSize);
-        grid[cellKey(cx, cy)].push_back(i);
+        int cx = cellCoord(posX[i]);
+        int cy = cellCoord(posY[i]);
+        int tx = cx >> TILE_SHIFT, ty = cy >> TILE_SHIFT;
+        if (lastTile < 0 || tx != lastTx || ty != lastTy) {
+            lastTile = findTile(tx, ty);
+            if (lastTile < 0) lastTile = acquireTile(tx, ty);
+            lastTx = tx;
+            lastTy = ty;
+        }
+        int local = (cy & (TILE - 1)) * TILE + (cx & (TILE - 1));
+        tiles[lastTile].cells[local].count++;
+        tiles[lastTile].population++;
+        particleCell[i] = lastTile * TILE_CELLS + local;
+    }
+
+    // Hand emptied tiles back, then lay the cells out back to back
+    int n = 0;
+    for (int t = 0; t < (int)tiles.size(); t++) {
+        Tile& tile = tiles[t];
+        if (!tile.live) continue;
+        if (tile.population == 0) {
+            releaseTile(t);
+            continue;
+        }
+        for (Cell& c : tile.cells) {
+            c.first = n;
+            n += c.count;
+            c.count = 0;
+        }
+    }
+    cellParticles.resize(count);
+    for (int i = 0; i < count; i++) {
+        int pc = particleCell[i];
+        Cell& c = tiles[pc / TILE_CELLS].cells[pc % TILE_CELLS];
+        cellParticles[c.first + c.count++] = i;
+    }
+
+    // Stamp each merged particle's reach onto the cells it overlaps. A pair
+    // kernel never exceeds the larger of the two radii, so this covers every
+    // cell whose particles must widen their search to see it. Cells with no
+    // particles search nothing, so missing tiles are skipped.
+    for (int i = 0; i < count; i++) {
+        int l = level[i];
+        if (l == 0) continue;
+        int reach = cellReach[l];
+        int t = particleCell[i] / TILE_CELLS, local = particleCell[i] % TILE_CELLS;
+        int lx = local & (TILE - 1), ly = local >> TILE_SHIFT;
+        for (int dx = -reach; dx <= reach; dx++) {
+            for (int dy = -reach; dy <= reach; dy++) {
+                Cell* c = cellNear(t, lx + dx, ly + dy);
+                if (c && l > c->reachLevel) c->reachLevel = l;
+            }
+        }
     }
 }
 
-// ---- SPH kernels & forces ----
+size_t SPHSimulation::gridBytes() const {
+    return tiles.capacity() * sizeof(Tile) +
+           tileSlots.size() * (sizeof(uint64_t) + 2 * sizeof(int) + sizeof(void*)) +
+           (cellParticles.capacity() + particleCell.capacity()) * sizeof(int);
+}
+
+void SPHSimulation::particlesInBox(float x0, float y0, float x1, float y1, std::vector<int>& out) {
+    if (!gridCurrent) buildGrid();
 
-void SPHSimulation::computeDensityPressure() {
-    const float mass = cfg::PARTICLE_MASS;
+    out.clear();
+    int cx0 = cellCoord(x0), cx1 = cellCoord(x1);
+    int cy0 = cellCoord(y0), cy1 = cellCoord(y1);
+    for (int cx = cx0; cx <= cx1; cx++) {
+        for (int cy = cy0; cy <= cy1; cy++) {
+            const Cell* c = cellAt(cx, cy);
+            if (!c) continue;
+            auto run = cellParticles.begin() + c->first;
+            out.insert(out.end(), run, run + c->count);
+        }
+    }
+}
 
+int SPHSimulation::searchReach(int i) const {
+    int l = homeCell(i).reachLevel;
+    return cellReach[l > level[i] ? l : level[i]];
+}
+
+// Call f(cell) for each occupied cell within `reach` cells of i's home cell
+template <class F>
+void SPHSimulation::forNeighbourCells(int i, int reach, F&& f) const {
+    int t = particleCell[i] / TILE_CELLS, local = particleCell[i] % TILE_CELLS;
+    int lx = local & (TILE - 1), ly = local >> TILE_SHIFT;
+    for (int dx = -reach; dx <= reach; dx++) {
+        for (int dy = -reach; dy <= reach; dy++) {
+            const Cell* c = cellNear(t, lx + dx, ly + dy);
+            if (c && c->count > 0) f(*c);
+        }
+    }
+}
+
+// ---- SPH kernels & forces ----
+
+// With Classify, the same neighbour loop also sums the colour-field
+// gradient sum_j m_j/rho_i grad W_ij and flags the free surface. The
+// neighbours' densities aren't known yet, so particle i's own stands in.
+template <class Kernel, bool Classify>
+void SPHSimulation::computeDensityPressure(const Kernel& kern) {
     for (int i = 0; i < count; i++) {
         float rho = 0.0f;
+        float gx = 0.0f, gy = 0.0f;
         float px = posX[i], py = posY[i];
-        int cx = (int)(px / cellSize);
-        int cy = (int)(py / cellSize);
-
-        for (int dx = -1; dx <= 1; dx++) {
-            for (int dy = -1; dy <= 1; dy++) {
-                auto it = grid.find(cellKey(cx + dx, cy + dy));
-                if (it == grid.end()) continue;
-                const auto& cell = it->second;
-
-                for (int k = 0; k < (int)cell.size(); k++) {
-                    int j = cell[k];
-                    float diffX = px - posX[j];
-                    float diffY = py - posY[j];
-                    float r2 = diffX * diffX + diffY * diffY;
-                    if (r2 < h2) {
-                        float w = h2 - r2;
-                        rho += mass * poly6Coeff * w * w * w;
+        int li = level[i];
+
+        forNeighbourCells(i, kern.reach(i), [&](const Cell& c) {
+            const int* cell = &cellParticles[c.first];
+            for (int k = 0; k < c.count; k++) {
+                int j = cell[k];
+                const PairKernel& kij = kern.pair(li, level[j]);
+                float diffX = px - posX[j];
+                float diffY = py - posY[j];
+                float r2 = diffX * diffX + diffY * diffY;
+                if (r2 < kij.h2) {
+                    float w = kij.h2 - r2;
+                    rho += mass[j] * kij.poly6 * w * w * w;
+                    if (Classify) {
+                        float g = mass[j] * -6.0f * kij.poly6 * w * w;
+                        gx += g * diffX;
+                        gy += g * diffY;
                     }
                 }
             }
-        }
+        });
 
         density[i]  = rho;
         float p = stiffness * (rho - restDensity);
         pressure[i] = (p > 0.0f) ? p : 0.0f;
+        if (Classify) onSurface[i] = isSurface(i, gx / rho, gy / rho);
     }
 }
 
-void SPHSimulation::computeForces() {
-    const float mass = cfg::PARTICLE_MASS;
-
+template <class Kernel>
+void SPHSimulation::computeForces(const Kernel& kern) {
     for (int i = 0; i < count; i++) {
         float fx = 0.0f, fy = 0.0f;
         float px = posX[i], py = posY[i];
         float pi_p = pressure[i];
         float vxi = velX[i], vyi = velY[i];
-        int cx = (int)(px / cellSize);
-        int cy = (int)(py / cellSize);
+        int li = level[i];
+
+        forNeighbourCells(i, kern.reach(i), [&](const Cell& c) {
+            const int* cell = &cellParticles[c.first];
+            for (int k = 0; k < c.count; k++) {
+                int j = cell[k];
+                if (i == j) continue;
 
-        for (int dx = -1; dx <= 1; dx++) {
-            for (int dy = -1; dy <= 1; dy++) {
-                auto it = grid.find(cellKey(cx + dx, cy + dy));
-                if (it == grid.end()) continue;
-                const auto& cell = it->second;
+                const PairKernel& kij = kern.pair(li, level[j]);
+                float diffX = px - posX[j];
+                float diffY = py - posY[j];
+                float r2 = diffX * diffX + diffY * diffY;
 
-                for (int k = 0; k < (int)cell.size(); k++) {
-                    int j = cell[k];
-                    if (i == j) continue;
+                if (r2 < kij.h2 && r2 > 1e-6f) {
+                    float r  = sqrtf(r2);
+                    float hr = kij.h - r;
+                    float dj = density[j];
+                    float mj = mass[j];
 
-                    float diffX = px - posX[j];
-                    float diffY = py - posY[j];
+                    // Pressure force (Spiky gradient kernel)
+                    float pMag = -mj * (pi_p + pressure[j]) / (2.0f * dj)
+                                 * kij.spikyGrad * hr * hr / r;
+                    fx += pMag * diffX;
+                    fy += pMag * diffY;
+
+                    // Viscosity force (Viscosity laplacian kernel)
+                    float vMag = viscosity * mj / dj * kij.viscLap * hr;
+                    fx += vMag * (velX[j] - vxi);
+                    fy += vMag * (velY[j] - vyi);
+                }
+            }
+        });
+
+        forceX[i] = fx;
+        forceY[i] = fy;
+    }
+}
+
+// Build the packed neighbour state from the current positions, velocities,
+// densities, pressures and levels, cell by cell.
+void SPHSimulation::packNeighbours() {
+    const float toFixed = 32767.0f / cellSize;
+    packed.resize(count);
+    for (const Tile& tile : tiles) {
+        if (!tile.live) continue;
+        for (int local = 0; local < TILE_CELLS; local++) {
+            const Cell& c = tile.cells[local];
+            const float ox = (float)(tile.tx * TILE + (local & (TILE - 1))) * cellSize;
+            const float oy = (float)(tile.ty * TILE + (local >> TILE_SHIFT)) * cellSize;
+            for (int k = c.first; k < c.first + c.count; k++) {
+                int j = cellParticles[k];
+                PackedParticle& q = packed[k];
+                float fx = (posX[j] - ox) * toFixed, fy = (posY[j] - oy) * toFixed;
+                q.ox = (uint16_t)((int)fminf(fmaxf(fx + 0.5f, 0.0f), 32767.0f) << 1 | (level[j] & 1));
+                q.oy = (uint16_t)((int)fminf(fmaxf(fy + 0.5f, 0.0f), 32767.0f) << 1 | (level[j] >> 1));
+                q.vx = toHalf(velX[j]);
+                q.vy = toHalf(velY[j]);
+                q.a  = mass[j] / (2.0f * density[j]);
+                q.b  = q.a * pressure[j];
+            }
+        }
+    }
+}
+
+// computeForces over the packed state. Particles are visited cell by cell.
+// Each home cell unpacks its neighbour runs, contiguous 16-byte records,
+// into a small float block once, and all of its particles loop over that
+// block with no index lookups. The home particles are the block's first
+// entries, so the loop touches no per-particle array except to store the
+// force. Positions are taken relative to the home cell's origin, which
+// keeps every coordinate small enough for the fixed-point offsets to lose
+// nothing in float. A particle meets itself at r2 = 0, which the distance
+// test already skips. Sums are accumulated in float as before.
+template <class Kernel>
+void SPHSimulation::computeForcesCompact(const Kernel& kern) {
+    const float toPixels = cellSize / 32767.0f;
+    NeighbourBlock& nb = neighbours;
+
+    for (int t = 0; t < (int)tiles.size(); t++) {
+        const Tile& tile = tiles[t];
+        if (!tile.live) continue;
+
+        for (int local = 0; local < TILE_CELLS; local++) {
+            const Cell& hc = tile.cells[local];
+            if (hc.count == 0) continue;
+            const int lx = local & (TILE - 1), ly = local >> TILE_SHIFT;
+            const int reach = kern.reach(hc);
+
+            nb.size = 0;
+            auto unpack = [&](const Cell& c, int dx, int dy) {
+                if ((int)nb.x.size() < nb.size + c.count) {
+                    int n = 2 * (nb.size + c.count);
+                    nb.x.resize(n); nb.y.resize(n); nb.vx.resize(n); nb.vy.resize(n);
+                    nb.a.resize(n); nb.b.resize(n); nb.level.resize(n);
+                }
+                const float ox = (float)dx * cellSize, oy = (float)dy * cellSize;
+                const PackedParticle* q = &packed[c.first];
+                for (int k = 0; k < c.count; k++) {
+                    int n = nb.size + k;
+                    nb.x[n]  = ox + (float)(q[k].ox >> 1) * toPixels;
+                    nb.y[n]  = oy + (float)(q[k].oy >> 1) * toPixels;
+                    nb.vx[n] = fromHalf(q[k].vx);
+                    nb.vy[n] = fromHalf(q[k].vy);
+                    nb.a[n]  = q[k].a;
+                    nb.b[n]  = q[k].b;
+                    nb.level[n] = (unsigned char)((q[k].ox & 1) | (q[k].oy & 1) << 1);
+                }
+                nb.size += c.count;
+            };
+            unpack(hc, 0, 0);
+            for (int dx = -reach; dx <= reach; dx++) {
+                for (int dy = -reach; dy <= reach; dy++) {
+                    const Cell* c = cellNear(t, lx + dx, ly + dy);
+                    if (c && c != &hc && c->count > 0) unpack(*c, dx, dy);
+                }
+            }
+
+            const float* bx = nb.x.data();
+            const float* by = nb.y.data();
+            const float* bvx = nb.vx.data();
+            const float* bvy = nb.vy.data();
+            const float* ba = nb.a.data();
+            const float* bb = nb.b.data();
+            const unsigned char* bl = nb.level.data();
+            for (int s = 0; s < hc.count; s++) {
+                float fx = 0.0f, fy = 0.0f;
+                float px = bx[s], py = by[s];
+                float pi_p = bb[s] / ba[s];
+                float vxi = bvx[s], vyi = bvy[s];
+                int li = bl[s];
+
+                for (int n = 0; n < nb.size; n++) {
+                    const PairKernel& kij = kern.pair(li, bl[n]);
+                    float diffX = px - bx[n];
+                    float diffY = py - by[n];
                     float r2 = diffX * diffX + diffY * diffY;
 
-                    if (r2 < h2 && r2 > 1e-6f) {
+                    if (r2 < kij.h2 && r2 > 1e-6f) {
                         float r  = sqrtf(r2);
-                        float hr = h - r;
-                        float dj = density[j];
+                        float hr = kij.h - r;
 
                         // Pressure force (Spiky gradient kernel)
-                        float pMag = -mass * (pi_p + pressure[j]) / (2.0f * dj)
-                                     * spikyGradCoeff * hr * hr / r;
+                        float pMag = -(pi_p * ba[n] + bb[n]) * kij.spikyGrad * hr * hr / r;
                         fx += pMag * diffX;
                         fy += pMag * diffY;
 
                         // Viscosity force (Viscosity laplacian kernel)
-                        float vMag = viscosity * mass / dj * viscLapCoeff * hr;
-                        fx += vMag * (velX[j] - vxi);
-                        fy += vMag * (velY[j] - vyi);
+                        float vMag = viscosity * 2.0f * ba[n] * kij.viscLap * hr;
+                        fx += vMag * (bvx[n] - vxi);
+                        fy += vMag * (bvy[n] - vyi);
                     }
                 }
+
+                int i = cellParticles[hc.first + s];
+                forceX[i] = fx;
+                forceY[i] = fy;
             }
         }
-
-        forceX[i] = fx;
-        forceY[i] = fy;
     }
 }
 
@@ -166,16 +741,22 @@ void SPHSimulation::integrate(float dt) {
     const float damping = cfg::BOUND_DAMPING;
     const float pad = cfg::BOUND_PAD;
 
-    const float minX = pad;
-    const float maxX = (float)width  - pad;
-    const float minY = pad;
-    const float maxY = (float)height - pad;
+    const float minX = bounds.x0 + pad;
+    const float maxX = bounds.x1 - pad;
+    const float minY = bounds.y0 + pad;
+    const float maxY = bounds.y1 - pad;
+    gridCurrent = false;
+
+    // Pressure, viscosity, gravity and every external field in one pass
+    const bool fields = !field.empty();
 
     for (int i = 0; i < count; i++) {
         float rho = density[i];
         if (rho > 1e-6f) {
-            velX[i] += dt * forceX[i] / rho;
-            velY[i] += dt * (forceY[i] / rho + gravity);
+            float ax = 0.0f, ay = 0.0f;
+            if (fields) field.sample(posX[i], posY[i], ax, ay);
+            velX[i] += dt * (forceX[i] / rho + ax);
+            velY[i] += dt * (forceY[i] / rho + gravity + ay);
         }
 
         posX[i] += dt * velX[i];
@@ -193,7 +774,7 @@ void SPHSimulation::applyMouseForce(float mx, float my, bool active) {
     if (!active) return;
     float r2max = cfg::MOUSE_RADIUS * cfg::MOUSE_RADIUS;
     float str   = cfg::MOUSE_STRENGTH;
-    float dt    = cfg::DT / (float)cfg::SUBSTEPS;
+    float dt    = scene.dt / (float)scene.substeps;
 
     for (int i = 0; i < count; i++) {
         float dx = posX[i] - mx;
@@ -208,16 +789,284 @@ void SPHSimulation::applyMouseForce(float mx, float my, bool active) {
     }
 }
 
-void SPHSimulation::step(float dt) {
+// ---- Adaptive resolution ----
+
+// Walls carry no particles, so a neighbourhood cut off by a wall looks like
+// a free surface. The gradient component pointing away from any wall within
+// one radius is dropped before the test.
+bool SPHSimulation::isSurface(int i, float gx, float gy) const {
+    float px = posX[i], py = posY[i];
+    float hi  = levelH[level[i]];
+    float pad = cfg::BOUND_PAD;
+    if (px - (bounds.x0 + pad) < hi && gx > 0.0f) gx = 0.0f;
+    if (bounds.x1 - pad - px < hi && gx < 0.0f) gx = 0.0f;
+    if (py - (bounds.y0 + pad) < hi && gy > 0.0f) gy = 0.0f;
+    if (bounds.y1 - pad - py < hi && gy < 0.0f) gy = 0.0f;
+    return sqrtf(gx * gx + gy * gy) * hi > cfg::SURFACE_GRADIENT;
+}
+
+// Surface particles are those with a strong colour-field gradient
+// |sum_j m_j/rho_j grad W_ij|, scaled by their own radius so the test is the
+// same at every level. Depth is then one relaxation sweep of
+// depth_i = min_j(depth_j + r_ij), pinned to zero on the surface. It runs once
+// per frame, so the estimate converges over a few frames and follows the
+// surface as it moves.
+void SPHSimulation::estimateDepthAndShear() {
+    for (int i = 0; i < count; i++) {
+        float px = posX[i], py = posY[i];
+        float vxi = velX[i], vyi = velY[i];
+        const PairKernel* ki = kernels[level[i]];
+
+        float gx = 0.0f, gy = 0.0f;
+        float d = 1e30f;
+        float s = 0.0f;
+
+        forNeighbourCells(i, searchReach(i), [&](const Cell& c) {
+            const int* cell = &cellParticles[c.first];
+            for (int k = 0; k < c.count; k++) {
+                int j = cell[k];
+                if (i == j) continue;
+
+                const PairKernel& kij = ki[level[j]];
+                float diffX = px - posX[j];
+                float diffY = py - posY[j];
+                float r2 = diffX * diffX + diffY * diffY;
+                if (r2 < kij.h2 && r2 > 1e-6f) {
+                    float w = kij.h2 - r2;
+                    float g = mass[j] / density[j] * -6.0f * kij.poly6 * w * w;
+                    gx += g * diffX;
+                    gy += g * diffY;
+
+                    float r = sqrtf(r2);
+                    if (depth[j] + r < d) d = depth[j] + r;
+
+                    float dvx = velX[j] - vxi;
+                    float dvy = velY[j] - vyi;
+                    float sh = sqrtf(dvx * dvx + dvy * dvy) / r;
+                    if (sh > s) s = sh;
+                }
+            }
+        });
+
+        depth[i] = (isSurface(i, gx, gy) || d > 1e29f) ? 0.0f : d;
+        shear[i] = s;
+    }
+}
+
+// Replace particle i by two children one level down, offset symmetrically
+// about the parent so mass, centre of mass and momentum are unchanged. The
+// split axis is the one of four candidates that keeps the children furthest
+// from existing neighbours — a child dropped on top of another particle
+// produces a pressure spike that launches both out of the fluid.
+void SPHSimulation::splitParticle(int i) {
+    int c = count++;
+    gridCurrent = false;
+    int l = level[i] - 1;
+    float off = 0.25f * levelH[l];
+    float px = posX[i], py = posY[i];
+    int reach = searchReach(i);
+
+    float bestClear = -1.0f, ox = off, oy = 0.0f;
+    for (int a = 0; a < 4; a++) {
+        float ax = off * cosf(a * PI * 0.25f);
+        float ay = off * sinf(a * PI * 0.25f);
+        float clear = 1e30f;
+        forNeighbourCells(i, reach, [&](const Cell& c) {
+            for (int k = c.first; k < c.first + c.count; k++) {
+                int j = cellParticles[k];
+                if (j == i || mass[j] == 0.0f) continue;
+                float ux = px + ax - posX[j], uy = py + ay - posY[j];
+                float vx = px - ax - posX[j], vy = py - ay - posY[j];
+                float d = fminf(ux * ux + uy * uy, vx * vx + vy * vy);
+                if (d < clear) clear = d;
+            }
+        });
+        if (clear > bestClear) { bestClear = clear; ox = ax; oy = ay; }
+    }
+
+    posX[c] = px - ox;       posY[c] = py - oy;
+    velX[c] = velX[i];       velY[c] = velY[i];
+    posX[i] = px + ox;       posY[i] = py + oy;
+
+    mass[i] *= 0.5f;
+    mass[c]  = mass[i];
+    level[i] = level[c] = (unsigned char)l;
+    density[c]  = density[i];
+    pressure[c] = pressure[i];
+    onSurface[c] = onSurface[i];
+    depth[c] = depth[i];
+    shear[c] = shear[i];
+}
+
+// Fold particle j into particle i one level up, conserving mass and momentum.
+void SPHSimulation::mergeParticles(int i, int j) {
+    float mi = mass[i], mj = mass[j];
+    float m  = mi + mj;
+    posX[i] = (mi * posX[i] + mj * posX[j]) / m;
+    posY[i] = (mi * posY[i] + mj * posY[j]) / m;
+    velX[i] = (mi * velX[i] + mj * velX[j]) / m;
+    velY[i] = (mi * velY[i] + mj * velY[j]) / m;
+    mass[i] = m;
+    level[i]++;
+}
+
+void SPHSimulation::adaptResolution() {
+    if (count == 0) return;
+
     buildGrid();
-    computeDensityPressure();
-    computeForces();
+    estimateDepthAndShear();
+
+    const float mergeDepth = cfg::MERGE_DEPTH * h;
+    const float splitDepth = cfg::SPLIT_DEPTH * h;
+    const float mergeShear = cfg::SPLIT_SHEAR * 0.5f;
+
+    // Splits first: children are appended past the grid, so they are never
+    // picked up as merge partners in the same frame.
+    int n = count;
+    for (int i = 0; i < n && count < capacity; i++) {
+        if (level[i] == 0) continue;
+        if (depth[i] < splitDepth || shear[i] > cfg::SPLIT_SHEAR)
+            splitParticle(i);
+    }
+
+    // Merges: pair each calm, deep particle with its nearest calm, deep
+    // neighbour of the same level. Absorbed particles are flagged by setting
+    // their mass to zero and compacted out afterwards.
+    bool merged = false;
+    for (int i = 0; i < n; i++) {
+        int li = level[i];
+        if (li >= cfg::MAX_LEVEL || mass[i] == 0.0f) continue;
+        if (depth[i] < mergeDepth || shear[i] > mergeShear) continue;
+
+        float px = posX[i], py = posY[i];
+        float best = levelH[li] * levelH[li] * 0.5625f;   // (0.75 h)^2
+        int   partner = -1;
+
+        forNeighbourCells(i, 1, [&](const Cell& c) {
+            for (int k = c.first; k < c.first + c.count; k++) {
+                int j = cellParticles[k];
+                if (j == i || level[j] != li || mass[j] == 0.0f) continue;
+                if (depth[j] < mergeDepth || shear[j] > mergeShear) continue;
+                float diffX = px - posX[j];
+                float diffY = py - posY[j];
+                float r2 = diffX * diffX + diffY * diffY;
+                if (r2 < best) { best = r2; partner = j; }
+            }
+        });
+
+        if (partner >= 0) {
+            mergeParticles(i, partner);
+            mass[partner] = 0.0f;
+            merged = true;
+        }
+    }
+
+    if (!merged) return;
+
+    int w = 0;
+    for (int i = 0; i < count; i++) {
+        if (mass[i] == 0.0f) continue;
+        if (w != i) {
+            posX[w] = posX[i];  posY[w] = posY[i];
+            velX[w] = velX[i];  velY[w] = velY[i];
+            mass[w] = mass[i];  level[w] = level[i];
+            density[w]  = density[i];
+            pressure[w] = pressure[i];
+            onSurface[w] = onSurface[i];
+            depth[w] = depth[i];
+            shear[w] = shear[i];
+        }
+        w++;
+    }
+    count = w;
+    gridCurrent = false;
+}
+
+template <class Kernel>
+void SPHSimulation::step(const Kernel& k, float dt, bool last) {
+    Clock::time_point t = Clock::now();
+    if (!gridCurrent) buildGrid();
+    timings.grid += elapsedMs(t);
+    if (last) computeDensityPressure<Kernel, true>(k);
+    else      computeDensityPressure<Kernel, false>(k);
+    timings.density += elapsedMs(t);
+    if (compactForces) {
+        packNeighbours();
+        computeForcesCompact(k);
+    } else {
+        computeForces(k);
+    }
+    timings.forces += elapsedMs(t);
     integrate(dt);
+    timings.integrate += elapsedMs(t);
+}
+
+// Substeps > 0 fixes the count at compile time so the loop unrolls;
+// 0 falls back to the scenario's run-time count.
+template <class Kernel, int Substeps>
+void SPHSimulation::runSubsteps(const Kernel& k, float dt) {
+    const int n = Substeps > 0 ? Substeps : scene.substeps;
+    for (int s = 0; s < n; s++) {
+        step(k, dt, s == n - 1);
+    }
 }
 
 void SPHSimulation::update() {
-    float subDt = cfg::DT / (float)cfg::SUBSTEPS;
-    for (int s = 0; s < cfg::SUBSTEPS; s++) {
-        step(subDt);
+    timings = PhaseTimings();
+    updateEmitters();
+    if (!field.empty()) field.bake(time);
+
+    float subDt = scene.dt / (float)scene.substeps;
+    withKernel([&](const auto& k) {
+        using K = std::decay_t<decltype(k)>;
+        switch (scene.substeps) {
+            case 4:  runSubsteps<K, 4>(k, subDt);  break;
+            case 8:  runSubsteps<K, 8>(k, subDt);  break;
+            case 16: runSubsteps<K, 16>(k, subDt); break;
+            default: runSubsteps<K, 0>(k, subDt);  break;
+        }
+    });
+    timings.substeps = scene.substeps;
+    time += scene.dt;
+
+    if (adaptive) {
+        Clock::time_point t = Clock::now();
+        adaptResolution();
+        timings.adapt = elapsedMs(t);
     }
 }
+
+SPHSimulation::ForceBench SPHSimulation::benchForces(int passes) {
+    ForceBench bench;
+    if (count == 0 || passes <= 0) return bench;
+
+    withKernel([&](const auto& k) {
+        buildGrid();
+        computeDensityPressure<std::decay_t<decltype(k)>, false>(k);
+
+        Clock::time_point t = Clock::now();
+        for (int p = 0; p < passes; p++) computeForces(k);
+        bench.floatMs = elapsedMs(t) / passes;
+        std::vector<float> refX(forceX.begin(), forceX.begin() + count);
+        std::vector<float> refY(forceY.begin(), forceY.begin() + count);
+
+        t = Clock::now();
+        for (int p = 0; p < passes; p++) {
+            packNeighbours();
+            computeForcesCompact(k);
+        }
+        bench.compactMs = elapsedMs(t) / passes;
+
+        double scale = 0.0, sum = 0.0;
+        for (int i = 0; i < count; i++)
+            scale = fmax(scale, sqrt((double)refX[i] * refX[i] + (double)refY[i] * refY[i]));
+        for (int i = 0; i < count; i++) {
+            double ex = forceX[i] - refX[i], ey = forceY[i] - refY[i];
+            double e  = sqrt(ex * ex + ey * ey) / (scale > 0.0 ? scale : 1.0);
+            bench.maxError = fmax(bench.maxError, e);
+            sum += e * e;
+        }
+        bench.rmsError = sqrt(sum / count);
+    });
+    return bench;
+}
@@ -1,51 +1,203 @@
 #pragma once
 
 #include "config.h"
+#include "force_field.h"
+#include "scenario.h"
+#include "scene_fill.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <unordered_map>
 #include <vector>
 
 class SPHSimulation {
 public:
+    explicit SPHSimulation(const Scenario& scenario);
     SPHSimulation(int width, int height);
 
+    void initScene();      // scenario blocks, or the dam break if there are none
     void initDamBreak();
     void update();
     void applyMouseForce(float mx, float my, bool active);
     void addParticle(float x, float y, float vx = 0, float vy = 0);
+    void pour(float x, float y);   // faucet: a few jittered particles at (x, y)
 
-    // Public particle data (read by renderer)
+    // Uniform in [0, 1) from the simulation's own generator. It restarts from
+    // the scenario seed on every reset, so a run depends only on the seed and
+    // the inputs it is given.
+    float random();
+
+    // FNV-1a over the positions and velocities of every live particle
+    uint64_t stateHash() const;
+
+    // Indices of particles in grid cells overlapping the box. The cells are
+    // coarser than the box, so callers still test distances themselves.
+    void particlesInBox(float x0, float y0, float x1, float y1, std::vector<int>& out);
+
+    // Grid tiles in use, and bytes held by the grid including pooled tiles
+    int    gridTiles() const { return (int)tileSlots.size(); }
+    size_t gridBytes() const;
+
+    // Public particle data (read by renderer and state export)
     int   count = 0;
-    float posX[cfg::MAX_PARTICLES];
-    float posY[cfg::MAX_PARTICLES];
+    int   capacity = 0;    // particle budget
+    std::vector<float> posX;
+    std::vector<float> posY;
+    std::vector<float> velX;
+    std::vector<float> velY;
+    std::vector<float> density;
+
+    // 1 for particles on the free surface, from the colour-field gradient
+    // taken during the last substep's density pass. The renderer splats
+    // these individually and fills the interior with a coarse layer.
+    std::vector<unsigned char> onSurface;
+
+    // Walls, from the scenario domain. Infinite edges are open.
+    Scenario::Block bounds;
 
     // Mutable runtime parameters
     float stiffness  = cfg::STIFFNESS;
     float viscosity  = cfg::VISCOSITY;
     float gravity    = cfg::GRAVITY;
     float restDensity = 0.0f;
+    bool  adaptive   = false;   // merge deep particles, split near the surface
+    bool  compactForces = false;   // read neighbours from the quantized copy in computeForces
+
+    // External forces (wind, vortices, attractors), re-baked every update()
+    ForceField field;
+    float      time = 0.0f;     // simulated seconds, drives time-varying fields
+
+    // Wall-clock time per phase, summed over the substeps of the last update()
+    struct PhaseTimings {
+        double grid = 0.0, density = 0.0, forces = 0.0, integrate = 0.0;  // ms
+        double adapt = 0.0;
+        int    substeps = 0;
+    };
+    PhaseTimings timings;
+
+    // Time the float and compact force passes on the current state and
+    // compare their results, relative to the largest force magnitude
+    struct ForceBench {
+        double floatMs = 0.0, compactMs = 0.0;   // per pass, packing included
+        double maxError = 0.0, rmsError = 0.0;
+    };
+    ForceBench benchForces(int passes);
 
 private:
+    Scenario scene;
     int width, height;
+    uint32_t rngState = 1;
+    SceneFiller filler;     // set up by fillShapes; computeRestDensity rebuilds its points
+
+    std::vector<float> pressure;
+    std::vector<float> forceX;
+    std::vector<float> forceY;
 
-    float velX[cfg::MAX_PARTICLES];
-    float velY[cfg::MAX_PARTICLES];
-    float density[cfg::MAX_PARTICLES];
-    float pressure[cfg::MAX_PARTICLES];
-    float forceX[cfg::MAX_PARTICLES];
-    float forceY[cfg::MAX_PARTICLES];
+    // Adaptive resolution state
+    std::vector<float> mass;
+    std::vector<unsigned char> level;
+    std::vector<float> depth;              // estimated distance to the free surface
+    std::vector<float> shear;              // max |dv|/r over neighbours
+    std::vector<float> emitAccum;          // fractional particles owed per emitter
 
-    // SPH kernel pre-computed coefficients
-    float h, h2;
-    float poly6Coeff, spikyGradCoeff, viscLapCoeff;
+    // SPH kernel pre-computed coefficients, indexed by the two particle levels.
+    // A pair uses the mean of both smoothing radii so forces stay symmetric.
+    float h;
+    struct PairKernel {
+        float h, h2;
+        float poly6, spikyGrad, viscLap;
+    };
+    float      levelH[cfg::MAX_LEVEL + 1];
+    PairKernel kernels[cfg::MAX_LEVEL + 1][cfg::MAX_LEVEL + 1];
+    int        cellReach[cfg::MAX_LEVEL + 1];  // neighbour cells to scan per level
 
-    // Spatial hash grid
+    // Kernel policies for the hot loops. FixedKernel<H> bakes a smoothing
+    // radius of H pixels into the code for scenes with no merged particles;
+    // TableKernel handles any radius and mixed levels at run time.
+    struct TableKernel;
+    template <int H> struct FixedKernel;
+
+    // Sparse spatial grid. Cells are grouped into TILE x TILE tiles drawn
+    // from a pool: a tile is taken when a particle lands in it and handed
+    // back once it empties, so memory follows the area the fluid covers,
+    // not the size of the domain. Tiles link to their eight neighbours, so
+    // the hot loops step between them without a lookup. reachLevel is the
+    // highest level of any particle whose kernel overlaps the cell, so small
+    // particles only widen their search where a larger one can reach them.
+    static constexpr int TILE_SHIFT = 3;
+    static constexpr int TILE       = 1 << TILE_SHIFT;   // cells per tile side
+    static constexpr int TILE_CELLS = TILE * TILE;
+    struct Cell {
+        int first = 0, count = 0;  // this cell's run in `cellParticles`
+        int reachLevel = 0;
+    };
+    struct Tile {
+        int  tx = 0, ty = 0;       // tile coordinates, in tiles
+        bool live = false;
+        int  population = 0;
+        int  link[9];              // tile at offset (ox, oy) is link[(oy + 1) * 3 + ox + 1], -1 if none
+        Cell cells[TILE_CELLS];
+    };
     float cellSize;
-    std::unordered_map<int, std::vector<int>> grid;
+    std::vector<Tile> tiles;
+    std::vector<int>  freeTiles;
+    std::unordered_map<uint64_t, int> tileSlots;   // (tx, ty) -> index in `tiles`
+    std::vector<int>  cellParticles;   // particle indices, grouped by cell
+    std::vector<int>  particleCell;    // tile * TILE_CELLS + cell within the tile
+    bool  gridCurrent = false;     // grid matches the current positions
+
+    // Quantized neighbour state for computeForcesCompact, parallel to
+    // `cellParticles`. The offset is 15-bit fixed point within the owning
+    // cell, with the particle's level spread over the two low bits;
+    // velocity is IEEE half, and density, pressure and mass fold into the
+    // two factors the force terms need: a = m/(2 rho) and b = m p/(2 rho).
+    struct PackedParticle {
+        uint16_t ox, oy;           // offset << 1 | one level bit each
+        uint16_t vx, vy;
+        float    a, b;
+    };
+    static_assert(cfg::MAX_LEVEL < 4, "PackedParticle holds two level bits");
+    std::vector<PackedParticle> packed;
 
-    int  cellKey(int cx, int cy) const;
+    // The neighbour runs of one home cell in computeForcesCompact, unpacked
+    // to float once and shared by all of its particles. Positions are
+    // relative to the home cell's origin; the home cell's run comes first.
+    struct NeighbourBlock {
+        std::vector<float> x, y, vx, vy, a, b;
+        std::vector<unsigned char> level;
+        int size = 0;
+    };
+    NeighbourBlock neighbours;
+
+    int  cellCoord(float p) const { return (int)floorf(p / cellSize); }
+    int  findTile(int tx, int ty) const;
+    int  acquireTile(int tx, int ty);
+    void releaseTile(int t);
+    // Cell (lx, ly) relative to tile t; may lie up to one tile outside it
+    Cell*       cellNear(int t, int lx, int ly);
+    const Cell* cellNear(int t, int lx, int ly) const;
+    const Cell* cellAt(int cx, int cy) const;
+    const Cell& homeCell(int i) const;
     void buildGrid();
-    void computeDensityPressure();
-    void computeForces();
+    int  searchReach(int i) const;
+    template <class F> void forNeighbourCells(int i, int reach, F&& f) const;
+    template <class Kernel, bool Classify> void computeDensityPressure(const Kernel& k);
+    template <class Kernel> void computeForces(const Kernel& k);
+    void packNeighbours();
+    template <class Kernel> void computeForcesCompact(const Kernel& k);
     void integrate(float dt);
-    void step(float dt);
+    template <class Kernel> void step(const Kernel& k, float dt, bool last);
+    template <class Kernel, int Substeps> void runSubsteps(const Kernel& k, float dt);
+    template <class F> void withKernel(F&& f);
+
+    void beginScene();
+    void fillShapes(const std::vector<FillShape>& shapes);
+    void computeRestDensity(const std::vector<FillShape>& shapes);
+    void updateEmitters();
+
+    bool isSurface(int i, float gx, float gy) const;
+    void estimateDepthAndShear();
+    void adaptResolution();
+    void splitParticle(int i);
+    void mergeParticles(int i, int j);
 };
@@ -0,0 +1,125 @@
+#include "state_export.h"
+#include "simulation.h"
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+StateExporter::~StateExporter() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool StateExporter::open(const char*, int, float, float, float, float) {
+    fprintf(stderr, "Shared-memory state export requires a POSIX system\n");
+    return false;
+}
+
+void StateExporter::close() {}
+
+#else
+
+bool StateExporter::open(const char* shmName, int capacity, float x0, float y0, float x1, float y1) {
+    close();
+
+    int fd = shm_open(shmName, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        perror("shm_open");
+        return false;
+    }
+
+    size_t bytes = shmstate::totalSize((uint32_t)capacity);
+    if (ftruncate(fd, (off_t)bytes) != 0) {
+        perror("ftruncate");
+        ::close(fd);
+        shm_unlink(shmName);
+        return false;
+    }
+
+    void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        shm_unlink(shmName);
+        return false;
+    }
+
+    // Invalidate the magic first so a reader that maps mid-initialisation
+    // rejects the segment instead of trusting a stale header.
+    header = (shmstate::Header*)mem;
+    header->magic = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    header->version    = shmstate::VERSION;
+    header->capacity   = (uint32_t)capacity;
+    header->slotCount  = shmstate::SLOTS;
+    header->slotStride = shmstate::slotStride((uint32_t)capacity);
+    header->x0 = x0;
+    header->y0 = y0;
+    header->x1 = x1;
+    header->y1 = y1;
+    header->latest.store(0, std::memory_order_relaxed);
+    header->published.store(0, std::memory_order_relaxed);
+    for (int s = 0; s < shmstate::SLOTS; s++) {
+        shmstate::SlotHeader* slot = shmstate::slotAt(mem, header, s);
+        slot->seq.store(0, std::memory_order_relaxed);
+        slot->frame = 0;
+        slot->count = 0;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = shmstate::MAGIC;
+
+    base  = mem;
+    size  = bytes;
+    name  = shmName;
+    frame = 0;
+    return true;
+}
+
+void StateExporter::close() {
+    if (!base) return;
+    munmap(base, size);
+    shm_unlink(name.c_str());
+    base   = nullptr;
+    header = nullptr;
+    size   = 0;
+}
+
+#endif
+
+void StateExporter::publish(const SPHSimulation& sim) {
+    publish(sim.count, sim.posX.data(), sim.posY.data(), sim.velX.data(), sim.velY.data(), sim.density.data());
+}
+
+void StateExporter::publish(int count, const float* posX, const float* posY,
+                            const float* velX, const float* velY, const float* density) {
+    if (!base) return;
+
+    uint32_t cap = header->capacity;
+    uint32_t n   = count < (int)cap ? (uint32_t)count : cap;
+    shmstate::SlotHeader* slot = shmstate::slotAt(base, header, (int)(frame % shmstate::SLOTS));
+
+    // Seqlock write: odd while the payload is in flux
+    uint64_t seq = slot->seq.load(std::memory_order_relaxed);
+    slot->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->frame = frame;
+    slot->count = n;
+    std::memcpy(shmstate::field(slot, cap, 0), posX,    n * sizeof(float));
+    std::memcpy(shmstate::field(slot, cap, 1), posY,    n * sizeof(float));
+    std::memcpy(shmstate::field(slot, cap, 2), velX,    n * sizeof(float));
+    std::memcpy(shmstate::field(slot, cap, 3), velY,    n * sizeof(float));
+    std::memcpy(shmstate::field(slot, cap, 4), density, n * sizeof(float));
+
+    slot->seq.store(seq + 2, std::memory_order_release);
+
+    header->latest.store(frame, std::memory_order_release);
+    header->published.store(frame + 1, std::memory_order_release);
+    frame++;
+}
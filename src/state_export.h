@@ -0,0 +1,31 @@
+#pragma once
+
+#include "state_layout.h"
+#include <string>
+
+class SPHSimulation;   // forward decl
+
+// Publishes each frame's particle state into a POSIX shared-memory ring so
+// local processes can map it and read without copies (see state_layout.h).
+// The simulation side never waits on readers.
+class StateExporter {
+public:
+    StateExporter() = default;
+    ~StateExporter();
+
+    // x0..y1 are the walls, as SPHSimulation::bounds; open sides are infinite
+    bool open(const char* name, int capacity, float x0, float y0, float x1, float y1);
+    void close();
+    void publish(const SPHSimulation& sim);
+    // The same from raw arrays of `count` floats each
+    void publish(int count, const float* posX, const float* posY,
+                 const float* velX, const float* velY, const float* density);
+    bool isOpen() const { return base != nullptr; }
+
+private:
+    std::string name;
+    void*   base = nullptr;
+    size_t  size = 0;
+    uint64_t frame = 0;
+    shmstate::Header* header = nullptr;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Shared-memory layout for live particle state (POSIX shm, e.g. /dev/shm).
+//
+//   [Header][Slot 0][Slot 1]...[Slot N-1]
+//
+// Each slot is a SlotHeader followed by `capacity` floats for each of
+// posX, posY, velX, velY, density. The writer fills slot (frame % N) under a
+// per-slot sequence lock: seq is odd while the slot is being written and
+// bumped to the next even value when it is complete. Readers never block
+// the writer; they read in place and discard the frame if seq changed.
+namespace shmstate {
+    constexpr uint32_t MAGIC   = 0x31485053;   // "SPH1"
+    constexpr uint32_t VERSION = 2;            // 2: domain walls replace width/height
+    constexpr int      SLOTS   = 3;
+    constexpr int      FIELDS  = 5;            // posX, posY, velX, velY, density
+    constexpr const char* DEFAULT_NAME = "/liquidsim";
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                  "shared-memory seqlock needs lock-free 64-bit atomics");
+
+    struct alignas(64) Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t capacity;                 // particles per slot
+        uint32_t slotCount;
+        uint64_t slotStride;               // bytes between slots
+        float    x0, y0, x1, y1;           // simulation walls; an open side is -inf or +inf
+        std::atomic<uint64_t> latest;      // frame number of newest complete slot
+        std::atomic<uint64_t> published;   // frames published so far (0 = none)
+    };
+
+    struct alignas(64) SlotHeader {
+        std::atomic<uint64_t> seq;
+        uint64_t frame;
+        uint32_t count;
+    };
+
+    inline size_t slotStride(uint32_t capacity) {
+        size_t bytes = sizeof(SlotHeader) + (size_t)FIELDS * capacity * sizeof(float);
+        return (bytes + 63) & ~(size_t)63;
+    }
+
+    inline size_t totalSize(uint32_t capacity) {
+        return sizeof(Header) + SLOTS * slotStride(capacity);
+    }
+
+    inline SlotHeader* slotAt(void* base, const Header* hdr, int slot) {
+        return (SlotHeader*)((char*)base + sizeof(Header) + slot * hdr->slotStride);
+    }
+
+    // Field f of a slot: 0 = posX, 1 = posY, 2 = velX, 3 = velY, 4 = density
+    inline float* field(SlotHeader* s, uint32_t capacity, int f) {
+        return (float*)(s + 1) + (size_t)f * capacity;
+    }
+}
@@ -0,0 +1,59 @@
+// StateMonitor — attaches to a running simulation's shared-memory export and
+// prints a once-per-second summary. Several instances can run at once; each
+// reports how many of its reads were torn by the writer.
+//
+//   StateMonitor [name] [seconds]
+
+#include "state_reader.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+int main(int argc, char** argv) {
+    const char* name = argc > 1 ? argv[1] : shmstate::DEFAULT_NAME;
+    int seconds      = argc > 2 ? atoi(argv[2]) : 0;   // 0 = run until killed
+
+    StateReader reader;
+    if (!reader.open(name)) return 1;
+    printf("Attached to %s (domain %g %g to %g %g)\n", name, reader.x0(), reader.y0(), reader.x1(), reader.y1());
+
+    using clock = std::chrono::steady_clock;
+    auto start  = clock::now();
+    auto report = start;
+    uint64_t seen = 0, frames = 0, reads = 0, torn = 0;
+
+    while (seconds == 0 || clock::now() - start < std::chrono::seconds(seconds)) {
+        StateFrame f;
+        if (reader.acquire(f) && f.frame + 1 != seen) {
+            // Reduce in place, then check the slot survived the read
+            double speed = 0.0, rho = 0.0;
+            for (uint32_t i = 0; i < f.count; i++) {
+                speed += std::sqrt(f.velX[i] * f.velX[i] + f.velY[i] * f.velY[i]);
+                rho   += f.density[i];
+            }
+            reads++;
+            if (!reader.valid(f)) {
+                torn++;
+            } else {
+                frames++;
+                seen = f.frame + 1;
+
+                auto now = clock::now();
+                if (now - report >= std::chrono::seconds(1)) {
+                    double dt = std::chrono::duration<double>(now - report).count();
+                    double n  = f.count ? (double)f.count : 1.0;
+                    printf("frame %llu  |  %5.1f fps  |  %u particles  |  mean speed %.1f  |  mean density %.4f  |  torn %llu/%llu\n",
+                           (unsigned long long)f.frame, frames / dt, f.count,
+                           speed / n, rho / n,
+                           (unsigned long long)torn, (unsigned long long)reads);
+                    frames = 0;
+                    report = now;
+                }
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return 0;
+}
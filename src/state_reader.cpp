@@ -0,0 +1,121 @@
+#include "state_reader.h"
+#include <cstdio>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+StateReader::~StateReader() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool StateReader::open(const char*) {
+    fprintf(stderr, "Shared-memory state export requires a POSIX system\n");
+    return false;
+}
+
+void StateReader::close() {}
+
+#else
+
+bool StateReader::open(const char* name) {
+    close();
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        perror("shm_open");
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(shmstate::Header)) {
+        fprintf(stderr, "Shared-memory segment %s is not initialised\n", name);
+        ::close(fd);
+        return false;
+    }
+
+    void* mem = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        return false;
+    }
+
+    const shmstate::Header* hdr = (const shmstate::Header*)mem;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (hdr->magic != shmstate::MAGIC || hdr->version != shmstate::VERSION ||
+        shmstate::totalSize(hdr->capacity) > (size_t)st.st_size) {
+        fprintf(stderr, "Shared-memory segment %s has an unknown layout\n", name);
+        munmap(mem, (size_t)st.st_size);
+        return false;
+    }
+
+    base   = mem;
+    size   = (size_t)st.st_size;
+    header = hdr;
+    return true;
+}
+
+void StateReader::close() {
+    if (!base) return;
+    munmap(const_cast<void*>(base), size);
+    base   = nullptr;
+    header = nullptr;
+    size   = 0;
+}
+
+#endif
+
+uint64_t StateReader::published() const {
+    return header ? header->published.load(std::memory_order_acquire) : 0;
+}
+
+bool StateReader::acquire(StateFrame& out) const {
+    if (published() == 0) return false;
+
+    uint64_t frame = header->latest.load(std::memory_order_acquire);
+    auto* slot = shmstate::slotAt(const_cast<void*>(base), header,
+                                  (int)(frame % header->slotCount));
+
+    uint64_t seq = slot->seq.load(std::memory_order_acquire);
+    if (seq & 1) return false;
+
+    uint32_t cap = header->capacity;
+    out.frame   = slot->frame;
+    out.count   = slot->count < cap ? slot->count : cap;
+    out.posX    = shmstate::field(slot, cap, 0);
+    out.posY    = shmstate::field(slot, cap, 1);
+    out.velX    = shmstate::field(slot, cap, 2);
+    out.velY    = shmstate::field(slot, cap, 3);
+    out.density = shmstate::field(slot, cap, 4);
+    out.slot    = slot;
+    out.seq     = seq;
+    return valid(out);
+}
+
+bool StateReader::valid(const StateFrame& f) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return f.slot && f.slot->seq.load(std::memory_order_relaxed) == f.seq;
+}
+
+bool StateReader::snapshot(StateSnapshot& out, int retries) const {
+    for (int attempt = 0; attempt < retries; attempt++) {
+        StateFrame f;
+        if (!acquire(f)) continue;
+
+        out.frame = f.frame;
+        out.posX.assign(f.posX, f.posX + f.count);
+        out.posY.assign(f.posY, f.posY + f.count);
+        out.velX.assign(f.velX, f.velX + f.count);
+        out.velY.assign(f.velY, f.velY + f.count);
+        out.density.assign(f.density, f.density + f.count);
+
+        if (valid(f)) return true;
+    }
+    return false;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "state_layout.h"
+#include <vector>
+
+// A frame of particle state read in place from shared memory. The pointers
+// alias the writer's ring slot: read what you need, then call
+// StateReader::valid() — if it returns false the writer lapped you and the
+// data may be torn, so discard it and acquire again.
+struct StateFrame {
+    uint64_t     frame = 0;
+    uint32_t     count = 0;
+    const float* posX = nullptr;
+    const float* posY = nullptr;
+    const float* velX = nullptr;
+    const float* velY = nullptr;
+    const float* density = nullptr;
+
+    const shmstate::SlotHeader* slot = nullptr;
+    uint64_t seq = 0;
+};
+
+// Owned copy of a frame, for readers that want to hold on to state.
+struct StateSnapshot {
+    uint64_t frame = 0;
+    std::vector<float> posX, posY, velX, velY, density;
+};
+
+// Read-only view of a StateExporter segment. Many readers can attach to the
+// same segment; none of them can stall the simulation.
+class StateReader {
+public:
+    StateReader() = default;
+    ~StateReader();
+
+    bool open(const char* name);
+    void close();
+    bool isOpen() const { return base != nullptr; }
+
+    // Walls of the simulation domain; an open side is -inf or +inf
+    float x0() const { return header->x0; }
+    float y0() const { return header->y0; }
+    float x1() const { return header->x1; }
+    float y1() const { return header->y1; }
+
+    // Number of frames the writer has published so far
+    uint64_t published() const;
+
+    // Newest complete frame, zero-copy. False if nothing is published yet or
+    // the writer is mid-way through that slot.
+    bool acquire(StateFrame& out) const;
+
+    // True if the frame was not overwritten while it was being read
+    bool valid(const StateFrame& f) const;
+
+    // Copy the newest frame, retrying on torn reads. False after `retries`
+    // failed attempts or if nothing is published yet.
+    bool snapshot(StateSnapshot& out, int retries = 8) const;
+
+private:
+    const void* base = nullptr;
+    size_t      size = 0;
+    const shmstate::Header* header = nullptr;
+};
@@ -0,0 +1,448 @@
+#include "surface.h"
+#include "simulation.h"
+#include "config.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point& since) {
+    Clock::time_point now = Clock::now();
+    double ms = std::chrono::duration<double, std::milli>(now - since).count();
+    since = now;
+    return ms;
+}
+
+// Nodes are re-sampled in square blocks so one grid query serves them all
+static constexpr int BLOCK = 4;
+
+// Frames between full rebuilds of the node densities
+static constexpr int REBUILD_FRAMES = 600;
+
+SurfaceExtractor::SurfaceExtractor(float nodeSpacing)
+    : spacing(nodeSpacing)
+{
+}
+
+void SurfaceExtractor::reset() {
+    full = true;
+}
+
+// ---- Node tiles ----
+
+static inline uint64_t tileKey(int tx, int ty) {
+    return ((uint64_t)(uint32_t)tx << 32) | (uint32_t)ty;
+}
+
+int SurfaceExtractor::findTile(int tx, int ty) const {
+    uint64_t key = tileKey(tx, ty);
+    LookupSlot& slot = lookup[(key * 0x9E3779B97F4A7C15ull) >> (64 - LOOKUP_BITS)];
+    if (slot.tile >= 0 && slot.key == key) return slot.tile;
+
+    auto it = tileSlots.find(key);
+    if (it == tileSlots.end()) return -1;
+    slot.key  = key;
+    slot.tile = it->second;
+    return it->second;
+}
+
+int SurfaceExtractor::acquireTile(int tx, int ty) {
+    int found = findTile(tx, ty);
+    if (found >= 0) return found;
+
+    int t = (int)tiles.size();
+    tiles.emplace_back();
+    Tile& tile = tiles.back();
+    tile.tx = tx;
+    tile.ty = ty;
+    std::fill(tile.density, tile.density + TILE_NODES, 0.0f);
+    std::fill(tile.dirty, tile.dirty + TILE_NODES, (unsigned char)0);
+    std::fill(tile.segments, tile.segments + TILE_NODES, (unsigned char)0);
+    tileSlots.emplace(tileKey(tx, ty), t);
+    edgeA.resize(tiles.size() * TILE_NODES * 2, -1);
+    edgeB.resize(tiles.size() * TILE_NODES * 2, -1);
+    orderStale = true;
+    return t;
+}
+
+// Make sure every node in [x0, x1] x [y0, y1] has a tile
+void SurfaceExtractor::coverNodes(int x0, int y0, int x1, int y1) {
+    for (int ty = y0 >> TILE_SHIFT; ty <= y1 >> TILE_SHIFT; ty++)
+        for (int tx = x0 >> TILE_SHIFT; tx <= x1 >> TILE_SHIFT; tx++)
+            acquireTile(tx, ty);
+}
+
+float SurfaceExtractor::densityAt(int ix, int iy) const {
+    int t = findTile(ix >> TILE_SHIFT, iy >> TILE_SHIFT);
+    if (t < 0) return 0.0f;
+    return tiles[t].density[((iy & (TILE - 1)) << TILE_SHIFT) + (ix & (TILE - 1))];
+}
+
+// ---- Node densities ----
+
+// Nodes a splat at (x, y) reaches, relative to the anchor. Splats also get
+// tiles one node beyond that, so every cell with a non-zero corner has all
+// four corners stored.
+static inline void splatRange(float x, float y, float r, float spacing, int& x0, int& y0, int& x1, int& y1) {
+    x0 = (int)ceilf((x - r) / spacing);
+    x1 = (int)floorf((x + r) / spacing);
+    y0 = (int)ceilf((y - r) / spacing);
+    y1 = (int)floorf((y + r) / spacing);
+}
+
+// Add (sign = +1) or remove (sign = -1) one particle's splat from the nodes
+// around it, flagging them as changed. The Gaussian factors into per-column
+// and per-row weights, so only one expf per node row and column is needed.
+void SurfaceExtractor::splatNodes(float x, float y, float sign) {
+    const float size = cfg::POINT_SIZE;
+    const float r    = size * 0.5f;
+    const float inv2 = 1.0f / (size * size);
+    x -= anchorX;
+    y -= anchorY;
+    int x0, y0, x1, y1;
+    splatRange(x, y, r, spacing, x0, y0, x1, y1);
+    if (x0 > x1 || y0 > y1) return;
+
+    // Look up the few tiles under the splat once. Adding also makes the
+    // tiles for a one-node margin around it.
+    const int tx0 = (x0 - 1) >> TILE_SHIFT, tx1 = (x1 + 1) >> TILE_SHIFT;
+    const int ty0 = (y0 - 1) >> TILE_SHIFT, ty1 = (y1 + 1) >> TILE_SHIFT;
+    int owner[MAX_SPAN / TILE + 2][MAX_SPAN / TILE + 2];
+    for (int ty = ty0; ty <= ty1; ty++)
+        for (int tx = tx0; tx <= tx1; tx++)
+            owner[ty - ty0][tx - tx0] = sign > 0.0f ? acquireTile(tx, ty) : findTile(tx, ty);
+
+    float dx2[MAX_SPAN], wx[MAX_SPAN];
+    for (int ix = x0; ix <= x1; ix++) {
+        float dx = ix * spacing - x;
+        dx2[ix - x0] = dx * dx * inv2;
+        wx[ix - x0]  = sign * expf(-dx2[ix - x0] * 18.0f);
+    }
+    for (int iy = y0; iy <= y1; iy++) {
+        float dy = iy * spacing - y;
+        float dy2 = dy * dy * inv2;
+        float wy = expf(-dy2 * 18.0f);
+        const int* row = owner[(iy >> TILE_SHIFT) - ty0];
+        for (int ix = x0; ix <= x1; ix++) {
+            if (dx2[ix - x0] + dy2 > 0.25f) continue;
+            int t = row[(ix >> TILE_SHIFT) - tx0];
+            if (t < 0) continue;
+            int n = ((iy & (TILE - 1)) << TILE_SHIFT) + (ix & (TILE - 1));
+            tiles[t].density[n] += wx[ix - x0] * wy;
+            tiles[t].dirty[n] = 1;
+        }
+    }
+}
+
+// Splat density at every node from scratch: sum of exp(-18 r2) over
+// particles with r2 = d^2 / POINT_SIZE^2 <= 0.25, as in SPLAT_FS. The
+// tiles are rebuilt from the particles' splats first, which drops any the
+// fluid has left. Nodes are gathered a block at a time from the
+// simulation's spatial grid.
+void SurfaceExtractor::sampleAllNodes(SPHSimulation& sim) {
+    const float size  = cfg::POINT_SIZE;
+    const float r     = size * 0.5f;
+    const float inv2  = 1.0f / (size * size);
+
+    tiles.clear();
+    tileSlots.clear();
+    for (LookupSlot& slot : lookup) slot.tile = -1;
+    orderStale = true;
+    for (int i = 0; i < sim.count; i++) {
+        int x0, y0, x1, y1;
+        splatRange(sim.posX[i] - anchorX, sim.posY[i] - anchorY, r, spacing, x0, y0, x1, y1);
+        if (x0 <= x1 && y0 <= y1) coverNodes(x0 - 1, y0 - 1, x1 + 1, y1 + 1);
+    }
+
+    for (Tile& tile : tiles) {
+        const int nx0 = tile.tx * TILE, ny0 = tile.ty * TILE;
+        for (int by = 0; by < TILE; by += BLOCK) {
+            for (int bx = 0; bx < TILE; bx += BLOCK) {
+                int ix0 = nx0 + bx, iy0 = ny0 + by;
+                sim.particlesInBox(anchorX + ix0 * spacing - r, anchorY + iy0 * spacing - r,
+                                   anchorX + (ix0 + BLOCK - 1) * spacing + r,
+                                   anchorY + (iy0 + BLOCK - 1) * spacing + r, nearby);
+
+                for (int ly = by; ly < by + BLOCK; ly++) {
+                    for (int lx = bx; lx < bx + BLOCK; lx++) {
+                        float x = anchorX + (nx0 + lx) * spacing, y = anchorY + (ny0 + ly) * spacing;
+                        float d = 0.0f;
+                        for (int j : nearby) {
+                            float dx = sim.posX[j] - x;
+                            float dy = sim.posY[j] - y;
+                            float r2 = (dx * dx + dy * dy) * inv2;
+                            if (r2 <= 0.25f) d += expf(-r2 * 18.0f);
+                        }
+                        int n = (ly << TILE_SHIFT) + lx;
+                        tile.density[n] = d;
+                        tile.dirty[n] = 1;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// ---- Contour ----
+
+// Neighbouring cells share an edge id, which links their segments
+void SurfaceExtractor::edgePoint(int edge, float& x, float& y) const {
+    const bool down = edge & 1;
+    const int  n0   = edge >> 1;
+    const Tile& tile = tiles[n0 / TILE_NODES];
+    const int  local = n0 % TILE_NODES;
+    const int  ix = tile.tx * TILE + (local & (TILE - 1));
+    const int  iy = tile.ty * TILE + (local >> TILE_SHIFT);
+    float d0 = tile.density[local];
+    float d1 = down ? densityAt(ix, iy + 1) : densityAt(ix + 1, iy);
+    float t = (cfg::THRESHOLD - d0) / (d1 - d0);
+    x = anchorX + ((float)ix + (down ? 0.0f : t)) * spacing;
+    y = anchorY + ((float)iy + (down ? t : 0.0f)) * spacing;
+}
+
+// Re-contour the cells of tile t that have a changed corner. Corners on the
+// right and bottom rows come from the neighbouring tiles; a missing tile
+// has no splat in it, so its nodes read as empty.
+void SurfaceExtractor::contourTile(int t) {
+    const float iso = cfg::THRESHOLD;
+    const int tx = tiles[t].tx, ty = tiles[t].ty;
+    const int right = findTile(tx + 1, ty), below = findTile(tx, ty + 1), diag = findTile(tx + 1, ty + 1);
+    Tile& tile = tiles[t];
+
+    // Node id of corner (lx, ly), which may be one past the tile's edge, or -1
+    auto nodeId = [&](int lx, int ly) {
+        int owner = lx < TILE ? (ly < TILE ? t : below) : (ly < TILE ? right : diag);
+        return owner < 0 ? -1 : owner * TILE_NODES + ((ly & (TILE - 1)) << TILE_SHIFT) + (lx & (TILE - 1));
+    };
+    auto density = [&](int id) { return id < 0 ? 0.0f : tiles[id / TILE_NODES].density[id % TILE_NODES]; };
+    auto dirty   = [&](int id) { return id >= 0 && tiles[id / TILE_NODES].dirty[id % TILE_NODES]; };
+
+    for (int ly = 0; ly < TILE; ly++) {
+        for (int lx = 0; lx < TILE; lx++) {
+            int n0 = nodeId(lx, ly);                          // corners: 0 top-left, 1 top-right,
+            int n1 = nodeId(lx + 1, ly);                      // 2 bottom-right, 3 bottom-left
+            int n2 = nodeId(lx + 1, ly + 1), n3 = nodeId(lx, ly + 1);
+            if (!(dirty(n0) || dirty(n1) || dirty(n2) || dirty(n3))) continue;
+            stats.dirtyCells++;
+
+            int c = (ly << TILE_SHIFT) + lx;
+            float d0 = density(n0), d1 = density(n1), d2 = density(n2), d3 = density(n3);
+            bool in0 = d0 >= iso, in1 = d1 >= iso, in2 = d2 >= iso, in3 = d3 >= iso;
+
+            int top = 2 * n0, rightEdge = 2 * n1 + 1, bottom = 2 * n3, left = 2 * n0 + 1;
+            int* e = &tile.edges[c * 4];
+
+            int crossing[4], k = 0;
+            if (in0 != in1) crossing[k++] = top;
+            if (in1 != in2) crossing[k++] = rightEdge;
+            if (in3 != in2) crossing[k++] = bottom;
+            if (in0 != in3) crossing[k++] = left;
+
+            if (k > 0 && (n1 < 0 || n2 < 0 || n3 < 0)) {
+                tile.segments[c] = 0;   // unreachable: splats cover a margin of tiles
+            } else if (k == 2) {
+                e[0] = crossing[0]; e[1] = crossing[1];
+                tile.segments[c] = 1;
+            } else if (k == 4) {
+                // Saddle: the cell centre decides which diagonal is connected
+                float centre = 0.25f * (d0 + d1 + d2 + d3);
+                if ((centre >= iso) == in0) {
+                    e[0] = top;    e[1] = rightEdge;   // cut off corners 1 and 3
+                    e[2] = bottom; e[3] = left;
+                } else {
+                    e[0] = left;      e[1] = top;      // cut off corners 0 and 2
+                    e[2] = rightEdge; e[3] = bottom;
+                }
+                tile.segments[c] = 2;
+            } else {
+                tile.segments[c] = 0;
+            }
+        }
+    }
+}
+
+// Join the cached segments into polylines by following shared edge ids.
+// Cells are visited in row order across the whole domain, tile by tile
+// along each row, so the output does not depend on when tiles were made.
+void SurfaceExtractor::linkSegments() {
+    if (orderStale) {
+        rowOrder.resize(tiles.size());
+        for (size_t t = 0; t < tiles.size(); t++) rowOrder[t] = (int)t;
+        std::sort(rowOrder.begin(), rowOrder.end(), [&](int a, int b) {
+            return tiles[a].ty != tiles[b].ty ? tiles[a].ty < tiles[b].ty : tiles[a].tx < tiles[b].tx;
+        });
+        orderStale = false;
+    }
+
+    std::vector<int> segs;      // edge id pairs
+    for (size_t first = 0, last; first < rowOrder.size(); first = last) {
+        for (last = first + 1; last < rowOrder.size() && tiles[rowOrder[last]].ty == tiles[rowOrder[first]].ty; last++) {}
+        for (int ly = 0; ly < TILE; ly++)
+            for (size_t k = first; k < last; k++) {
+                const Tile& tile = tiles[rowOrder[k]];
+                for (int c = ly << TILE_SHIFT; c < (ly + 1) << TILE_SHIFT; c++)
+                    for (int s = 0; s < tile.segments[c]; s++) {
+                        segs.push_back(tile.edges[c * 4 + s * 2]);
+                        segs.push_back(tile.edges[c * 4 + s * 2 + 1]);
+                    }
+            }
+    }
+
+    int count = (int)segs.size() / 2;
+    stats.segments = count;
+    for (int s = 0; s < count; s++) {
+        for (int end = 0; end < 2; end++) {
+            int edge = segs[s * 2 + end];
+            if (edgeA[edge] < 0) edgeA[edge] = s;
+            else                 edgeB[edge] = s;
+        }
+    }
+
+    // Segment across `edge` from segment s, or -1
+    auto across = [&](int edge, int s) {
+        return edgeA[edge] == s ? edgeB[edge] : edgeA[edge];
+    };
+
+    lines.clear();
+    std::vector<bool> used(count, false);
+    std::vector<int>  chain;
+    for (int start = 0; start < count; start++) {
+        if (used[start]) continue;
+
+        // Walk forward from the start segment's second edge, then backward
+        // from its first edge if the loop did not close
+        chain.assign(1, segs[start * 2]);
+        used[start] = true;
+        bool closed = false;
+        int s = start, edge = segs[start * 2 + 1];
+        for (;;) {
+            chain.push_back(edge);
+            int next = across(edge, s);
+            if (next < 0) break;
+            if (next == start) { closed = true; chain.pop_back(); break; }
+            if (used[next]) break;
+            used[next] = true;
+            edge = segs[next * 2] == edge ? segs[next * 2 + 1] : segs[next * 2];
+            s = next;
+        }
+        if (!closed) {
+            std::vector<int> back;
+            s = start; edge = segs[start * 2];
+            for (int next = across(edge, s); next >= 0 && !used[next]; next = across(edge, s)) {
+                used[next] = true;
+                edge = segs[next * 2] == edge ? segs[next * 2 + 1] : segs[next * 2];
+                back.push_back(edge);
+                s = next;
+            }
+            chain.insert(chain.begin(), back.rbegin(), back.rend());
+        }
+
+        Polyline line;
+        line.closed = closed;
+        line.points.reserve(chain.size() * 2);
+        for (int e : chain) {
+            float x, y;
+            edgePoint(e, x, y);
+            line.points.push_back(x);
+            line.points.push_back(y);
+        }
+        lines.push_back(std::move(line));
+    }
+
+    for (int e : segs) { edgeA[e] = -1; edgeB[e] = -1; }
+}
+
+void SurfaceExtractor::update(SPHSimulation& sim) {
+    stats = Stats();
+    Clock::time_point t = Clock::now();
+
+    // ---- Bring node densities up to date ----
+    // Incrementally, by moving the splats of particles that drifted more
+    // than SURFACE_EPSILON since they were last applied. A periodic full
+    // rebuild stops rounding error from accumulating.
+    const float eps2 = cfg::SURFACE_EPSILON * cfg::SURFACE_EPSILON;
+    const int n = sim.count;
+    const Scenario::Block& walls = sim.bounds;
+    float ax = std::isinf(walls.x0) ? 0.0f : walls.x0;
+    float ay = std::isinf(walls.y0) ? 0.0f : walls.y0;
+    if (ax != anchorX || ay != anchorY) full = true;
+    anchorX = ax;
+    anchorY = ay;
+    wallX0 = walls.x0; wallY0 = walls.y0;
+    wallX1 = walls.x1; wallY1 = walls.y1;
+    if ((int)seenX.size() < n) {
+        seenX.resize(n);
+        seenY.resize(n);
+    }
+
+    if (full || ++framesSinceRebuild >= REBUILD_FRAMES) {
+        sampleAllNodes(sim);
+        for (int i = 0; i < n; i++) { seenX[i] = sim.posX[i]; seenY[i] = sim.posY[i]; }
+        full = false;
+        framesSinceRebuild = 0;
+    } else {
+        for (int i = 0; i < std::max(n, seenCount); i++) {
+            bool had = i < seenCount, has = i < n;
+            if (had && has) {
+                float dx = sim.posX[i] - seenX[i];
+                float dy = sim.posY[i] - seenY[i];
+                if (dx * dx + dy * dy <= eps2) continue;
+            }
+            if (had) splatNodes(seenX[i], seenY[i], -1.0f);
+            if (has) {
+                splatNodes(sim.posX[i], sim.posY[i], 1.0f);
+                seenX[i] = sim.posX[i];
+                seenY[i] = sim.posY[i];
+            }
+        }
+    }
+    seenCount = n;
+    for (const Tile& tile : tiles)
+        for (int k = 0; k < TILE_NODES; k++) stats.dirtyNodes += tile.dirty[k];
+    stats.densityMs = elapsedMs(t);
+
+    // ---- Re-contour cells with a re-sampled corner ----
+    for (int t = 0; t < (int)tiles.size(); t++) contourTile(t);
+    for (Tile& tile : tiles) std::fill(tile.dirty, tile.dirty + TILE_NODES, (unsigned char)0);
+    stats.contourMs = elapsedMs(t);
+
+    linkSegments();
+    stats.linkMs = elapsedMs(t);
+}
+
+bool SurfaceExtractor::writeSVG(const char* path) const {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Cannot write surface: %s\n", path);
+        return false;
+    }
+    // The domain, with open sides closed at the furthest tile
+    float x0 = wallX0, y0 = wallY0, x1 = wallX1, y1 = wallY1;
+    if (std::isinf(x0) || std::isinf(y0) || std::isinf(x1) || std::isinf(y1)) {
+        int tx0 = 0, ty0 = 0, tx1 = 0, ty1 = 0;
+        for (size_t t = 0; t < tiles.size(); t++) {
+            tx0 = t ? std::min(tx0, tiles[t].tx) : tiles[t].tx;
+            ty0 = t ? std::min(ty0, tiles[t].ty) : tiles[t].ty;
+            tx1 = t ? std::max(tx1, tiles[t].tx) : tiles[t].tx;
+            ty1 = t ? std::max(ty1, tiles[t].ty) : tiles[t].ty;
+        }
+        const float extent = TILE * spacing;
+        if (std::isinf(x0)) x0 = anchorX + tx0 * extent;
+        if (std::isinf(y0)) y0 = anchorY + ty0 * extent;
+        if (std::isinf(x1)) x1 = anchorX + (tx1 + 1) * extent;
+        if (std::isinf(y1)) y1 = anchorY + (ty1 + 1) * extent;
+    }
+    fprintf(f, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%g\" height=\"%g\" viewBox=\"%g %g %g %g\">\n",
+            x1 - x0, y1 - y0, x0, y0, x1 - x0, y1 - y0);
+    for (const Polyline& line : lines) {
+        fprintf(f, "<%s fill=\"none\" stroke=\"#2680e6\" points=\"", line.closed ? "polygon" : "polyline");
+        for (size_t k = 0; k < line.points.size(); k += 2)
+            fprintf(f, "%s%.2f,%.2f", k ? " " : "", line.points[k], line.points[k + 1]);
+        fprintf(f, "\"/>\n");
+    }
+    fprintf(f, "</svg>\n");
+    fclose(f);
+    return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class SPHSimulation;   // forward decl
+
+// Free-surface contour as polylines. The density of the splat pass is
+// sampled on a coarse node grid and marching squares traces its THRESHOLD
+// iso-line, so the contour matches what the renderer draws.
+//
+// The extractor is incremental. Node densities are built once from the
+// simulation's spatial grid; after that, a particle that has moved since
+// its splat was last applied has the splat taken off its old position and
+// added at the new one. Only cells with a changed corner are re-contoured;
+// every other cell keeps its cached segments.
+//
+// Nodes are stored in tiles that exist only where some splat reaches, so
+// the extractor follows the fluid over a domain of any size, open sides
+// included. Each tile also holds the cells whose top-left corner is one of
+// its nodes. Tiles left behind by moving fluid are dropped at the next
+// full rebuild.
+class SurfaceExtractor {
+public:
+    struct Polyline {
+        std::vector<float> points;   // x, y pairs in simulation pixels
+        bool closed = false;
+    };
+
+    // Work done by the last update()
+    struct Stats {
+        int    dirtyNodes = 0;      // nodes whose density changed
+        int    dirtyCells = 0;      // cells re-contoured
+        int    segments   = 0;      // segments on the whole contour
+        double densityMs  = 0.0;    // updating node densities
+        double contourMs  = 0.0;    // marching squares on dirty cells
+        double linkMs     = 0.0;    // joining segments into polylines
+    };
+
+    explicit SurfaceExtractor(float spacing);
+
+    void update(SPHSimulation& sim);
+    void reset();                   // force a full rebuild on the next update
+    bool writeSVG(const char* path) const;
+
+    int tileCount() const { return (int)tiles.size(); }
+
+    std::vector<Polyline> lines;
+    Stats stats;
+
+private:
+    static constexpr int TILE_SHIFT = 4;
+    static constexpr int TILE       = 1 << TILE_SHIFT;   // nodes per tile side
+    static constexpr int TILE_NODES = TILE * TILE;
+
+    // Node (ix, iy) sits at (anchorX + ix * spacing, anchorY + iy * spacing)
+    // in tile (ix >> TILE_SHIFT, iy >> TILE_SHIFT). Its id is
+    // tile * TILE_NODES + its index within the tile.
+    struct Tile {
+        int tx = 0, ty = 0;
+        float         density[TILE_NODES];
+        unsigned char dirty[TILE_NODES];
+        unsigned char segments[TILE_NODES];   // cells with their top-left corner here
+        int           edges[TILE_NODES * 4];
+    };
+
+    float spacing;
+    float anchorX = 0.0f, anchorY = 0.0f;     // the low walls, or 0 where open
+    float wallX0 = 0.0f, wallY0 = 0.0f, wallX1 = 0.0f, wallY1 = 0.0f;   // for writeSVG
+
+    std::vector<Tile> tiles;
+    std::unordered_map<uint64_t, int> tileSlots;   // (tx, ty) -> index in `tiles`
+
+    // Direct-mapped cache in front of tileSlots. Splats look up the same
+    // few tiles over and over, and a hit skips the hash map.
+    struct LookupSlot {
+        uint64_t key = 0;
+        int      tile = -1;
+    };
+    static constexpr int LOOKUP_BITS = 10;
+    mutable std::vector<LookupSlot> lookup = std::vector<LookupSlot>(1 << LOOKUP_BITS);
+    std::vector<int> rowOrder;        // tiles sorted by (ty, tx), for linking in row order
+    bool orderStale = true;
+
+    // Position of each particle index whose splat the node densities hold
+    std::vector<float> seenX, seenY;
+    int  seenCount = 0;
+    bool full = true;
+    int  framesSinceRebuild = 0;
+
+    // Segment linking scratch: the (up to two) segments touching each edge.
+    // Edge ids are 2 * node id for the edge to the right of a node and
+    // 2 * node id + 1 for the edge below it.
+    std::vector<int> edgeA, edgeB;
+    std::vector<int> nearby;
+
+    // Widest run of nodes one splat can cover
+    static constexpr int MAX_SPAN = 64;
+
+    int   findTile(int tx, int ty) const;
+    int   acquireTile(int tx, int ty);
+    void  coverNodes(int x0, int y0, int x1, int y1);
+    float densityAt(int ix, int iy) const;
+    void  splatNodes(float x, float y, float sign);
+    void  sampleAllNodes(SPHSimulation& sim);
+    void  contourTile(int t);
+    void  linkSegments();
+    void  edgePoint(int edge, float& x, float& y) const;
+};
@@ -0,0 +1,155 @@
+#include "telemetry.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// ---- Allocation counting ----
+//
+// Replacing the global allocator is the only way to see allocations made
+// inside the standard library (grid vectors, hash map nodes). The cost is
+// one relaxed atomic increment per allocation.
+
+static std::atomic<uint64_t> g_allocations{0};
+
+uint64_t allocationCount() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+// ---- Server ----
+
+TelemetryServer::~TelemetryServer() {
+    stop();
+}
+
+void TelemetryServer::publish(const TelemetryMetrics& m) {
+    if (!running.load(std::memory_order_relaxed)) return;
+    std::unique_lock<std::mutex> guard(lock, std::try_to_lock);
+    if (guard.owns_lock()) latest = m;
+}
+
+#ifdef _WIN32
+
+bool TelemetryServer::start(const char*) {
+    fprintf(stderr, "Telemetry socket requires a POSIX system\n");
+    return false;
+}
+
+void TelemetryServer::stop() {}
+void TelemetryServer::serve() {}
+
+#else
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0   // macOS: SO_NOSIGPIPE is set per socket instead
+#endif
+
+static int formatJson(char* buf, size_t size, const TelemetryMetrics& m) {
+    return snprintf(buf, size,
+        "{\"frame\":%llu,\"frame_ms\":%.3f,\"fps\":%.1f,\"particles\":%d,\"substeps\":%d,"
+        "\"sim_ms\":{\"grid\":%.3f,\"density\":%.3f,\"forces\":%.3f,\"integrate\":%.3f,\"adapt\":%.3f},"
+        "\"render_ms\":{\"splat\":%.3f,\"composite\":%.3f,\"upload\":%.3f},"
+        "\"surface\":{\"ms\":%.3f,\"dirty_cells\":%d},"
+        "\"allocations\":{\"frame\":%llu,\"total\":%llu}}\n",
+        (unsigned long long)m.frame, m.frameMs, m.fps, m.particles, m.substeps,
+        m.gridMs, m.densityMs, m.forcesMs, m.integrateMs, m.adaptMs,
+        m.splatMs, m.compositeMs, m.uploadMs,
+        m.surfaceMs, m.surfaceCells,
+        (unsigned long long)m.allocations, (unsigned long long)m.allocationsTotal);
+}
+
+bool TelemetryServer::start(const char* socketPath) {
+    stop();
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (std::strlen(socketPath) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Telemetry socket path too long: %s\n", socketPath);
+        return false;
+    }
+    std::strcpy(addr.sun_path, socketPath);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return false;
+    }
+
+    unlink(socketPath);   // stale socket from a previous run
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+        perror("telemetry bind/listen");
+        ::close(fd);
+        return false;
+    }
+
+    path     = socketPath;
+    listenFd = fd;
+    running.store(true);
+    worker = std::thread(&TelemetryServer::serve, this);
+    return true;
+}
+
+void TelemetryServer::stop() {
+    if (!running.exchange(false)) return;
+    if (worker.joinable()) worker.join();
+    ::close(listenFd);
+    unlink(path.c_str());
+    listenFd = -1;
+}
+
+// Accept loop. poll() with a timeout lets stop() take effect without
+// needing to wake a blocked accept().
+void TelemetryServer::serve() {
+    char buf[1024];
+    while (running.load()) {
+        pollfd pfd{listenFd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) continue;
+
+        int client = accept(listenFd, nullptr, nullptr);
+        if (client < 0) continue;
+#ifdef SO_NOSIGPIPE
+        int one = 1;
+        setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+        TelemetryMetrics m;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            m = latest;
+        }
+
+        int len = formatJson(buf, sizeof(buf), m);
+        const char* p = buf;
+        while (len > 0) {
+            ssize_t n = send(client, p, (size_t)len, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            p   += n;
+            len -= (int)n;
+        }
+        ::close(client);
+    }
+}
+
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// One frame's worth of metrics, as served to telemetry clients
+struct TelemetryMetrics {
+    uint64_t frame     = 0;
+    double   frameMs   = 0.0;
+    double   fps       = 0.0;
+    int      particles = 0;
+    int      substeps  = 0;
+
+    // Simulation phases, summed over the frame's substeps (ms)
+    double gridMs = 0.0, densityMs = 0.0, forcesMs = 0.0, integrateMs = 0.0;
+    double adaptMs = 0.0;
+
+    // GPU render passes, and CPU time spent uploading positions (ms)
+    double splatMs = 0.0, compositeMs = 0.0;
+    double uploadMs = 0.0;
+
+    // Surface extraction (ms), and cells re-contoured this frame
+    double surfaceMs    = 0.0;
+    int    surfaceCells = 0;
+
+    // Heap allocations made during the frame, and since startup
+    uint64_t allocations      = 0;
+    uint64_t allocationsTotal = 0;
+};
+
+// Number of global operator new calls since startup (process-wide)
+uint64_t allocationCount();
+
+// Serves the latest TelemetryMetrics as a single JSON line to every client
+// that connects to a Unix domain socket, then closes the connection:
+//
+//   nc -U /tmp/liquidsim.sock
+//
+// publish() is called from the simulation thread and never waits: if the
+// server is in the middle of copying the previous frame, the update is
+// dropped and the next frame's is taken instead.
+class TelemetryServer {
+public:
+    TelemetryServer() = default;
+    ~TelemetryServer();
+
+    bool start(const char* socketPath);
+    void stop();
+    void publish(const TelemetryMetrics& m);
+    bool isRunning() const { return running.load(); }
+
+private:
+    std::string       path;
+    int               listenFd = -1;
+    std::thread       worker;
+    std::atomic<bool> running{false};
+
+    std::mutex        lock;      // guards latest
+    TelemetryMetrics  latest;
+
+    void serve();
+};
@@ -0,0 +1,67 @@
+#include "worker_pool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(int threads) {
+    if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    for (int k = 1; k < threads; k++) workers.emplace_back(&WorkerPool::serve, this);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers) t.join();
+}
+
+void WorkerPool::drain(Job fn, void* ctx, int n) {
+    for (int k = next.fetch_add(1); k < n; k = next.fetch_add(1)) fn(ctx, k);
+}
+
+// Every worker wakes for every job and reports back, even if the indices
+// ran out before it got one, so the job never outlives the caller's frame
+void WorkerPool::run(int n, Job fn, void* ctx) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        job = fn;
+        jobCtx = ctx;
+        jobSize = n;
+        done = 0;
+        next.store(0);
+        generation++;
+    }
+    wake.notify_all();
+
+    drain(fn, ctx, n);
+
+    std::unique_lock<std::mutex> guard(lock);
+    finished.wait(guard, [&] { return done == (int)workers.size(); });
+    job = nullptr;
+}
+
+void WorkerPool::serve() {
+    uint64_t seen = 0;
+    for (;;) {
+        Job fn;
+        void* ctx;
+        int n;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&] { return quit || generation != seen; });
+            if (quit) return;
+            seen = generation;
+            fn = job;
+            ctx = jobCtx;
+            n = jobSize;
+        }
+
+        drain(fn, ctx, n);
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            done++;
+        }
+        finished.notify_one();
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Threads started once and reused for every parallel loop, so a pass that
+// runs each frame does not pay for creating and joining threads. The
+// calling thread takes part in the loop, so a pool of size 1 runs
+// everything inline and starts no threads at all.
+class WorkerPool {
+public:
+    explicit WorkerPool(int threads = 0);   // 0 = one per core
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int size() const { return (int)workers.size() + 1; }
+
+    // Run f(k) for every k in [0, n), handing out indices one at a time,
+    // and return once all of them are done. Not re-entrant.
+    template <class F>
+    void forEach(int n, F&& f) {
+        using Fn = typename std::remove_reference<F>::type;
+        if (workers.empty() || n <= 1) {
+            for (int k = 0; k < n; k++) f(k);
+            return;
+        }
+        run(n, [](void* ctx, int k) { (*static_cast<Fn*>(ctx))(k); }, &f);
+    }
+
+private:
+    using Job = void (*)(void* ctx, int k);
+
+    std::vector<std::thread> workers;
+    std::mutex              lock;
+    std::condition_variable wake;       // a new job was posted, or quit
+    std::condition_variable finished;   // a worker is done with the job
+
+    // Current job, guarded by `lock` except `next`
+    Job      job = nullptr;
+    void*    jobCtx = nullptr;
+    int      jobSize = 0;
+    uint64_t generation = 0;            // bumped once per job
+    int      done = 0;                  // workers finished with this job
+    bool     quit = false;
+    std::atomic<int> next{0};
+
+    void run(int n, Job fn, void* ctx);
+    void drain(Job fn, void* ctx, int n);
+    void serve();
+};
@@ -0,0 +1,228 @@
+// StateExportTest — forks one writer and several readers over a private
+// shared-memory segment and fails if any reader accepts a torn frame or
+// sees the writer's sequence go wrong.
+//
+//   StateExportTest [readers] [frames] [particles]
+//
+// The writer publishes frames whose every value is a function of the frame
+// number, field and index, with a particle count that changes from frame
+// to frame. Each reader verifies whatever it reads in place, then asks the
+// seqlock whether the read stood. A frame the seqlock accepts must match
+// exactly. Checks on every accepted frame:
+//   - the payload and count are the ones published for that frame number
+//   - the slot's sequence number is the one the ring gives that frame
+//     (each slot is bumped by 2 per write)
+//   - frame numbers never go backwards, and `published` covers the frame
+// Readers also check the header carries the walls, open side included.
+// Every reader must also reach the writer's last frame before the timeout.
+// Readers alternate between zero-copy acquire() and snapshot().
+
+#include "state_export.h"
+#include "state_reader.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr int TIMEOUT_SECONDS = 60;
+
+static uint32_t countFor(uint64_t frame, uint32_t capacity) {
+    return capacity - (uint32_t)(frame % 97);
+}
+
+// Exact in float: the value stays below 2^24
+static float valueFor(uint64_t frame, int field, uint32_t i) {
+    return (float)(((uint32_t)frame * 40503u + (uint32_t)field * 7919u + i * 31u) & 0xFFFFFFu);
+}
+
+// Walls the writer publishes: no ceiling, like scenarios/long_channel.txt
+static const float WALLS[4] = { 0.0f, -INFINITY, 20000.0f, 600.0f };
+
+static int runWriter(const char* name, int frames, uint32_t capacity, int ready) {
+    StateExporter exporter;
+    if (!exporter.open(name, (int)capacity, WALLS[0], WALLS[1], WALLS[2], WALLS[3])) return 1;
+    if (write(ready, "R", 1) != 1) return 1;
+    close(ready);
+
+    std::vector<float> data[shmstate::FIELDS];
+    for (std::vector<float>& d : data) d.resize(capacity);
+
+    for (int f = 0; f < frames; f++) {
+        uint32_t n = countFor((uint64_t)f, capacity);
+        for (int k = 0; k < shmstate::FIELDS; k++)
+            for (uint32_t i = 0; i < n; i++) data[k][i] = valueFor((uint64_t)f, k, i);
+        exporter.publish((int)n, data[0].data(), data[1].data(), data[2].data(), data[3].data(), data[4].data());
+        sched_yield();   // let readers in mid-ring, so some reads get lapped
+    }
+
+    // Keep the segment until the readers have attached; they keep their
+    // own mapping after it is unlinked
+    sleep(1);
+    return 0;
+}
+
+struct ReaderStats {
+    uint64_t accepted = 0, torn = 0, busy = 0, skipped = 0;
+};
+
+// True if the payload is exactly what the writer published for `frame`;
+// otherwise `why` names the first mismatch
+static bool payloadMatches(uint64_t frame, uint32_t count, uint32_t capacity, const float* const fields[],
+                           std::string& why) {
+    if (count != countFor(frame, capacity)) {
+        why = "count " + std::to_string(count) + ", expected " + std::to_string(countFor(frame, capacity));
+        return false;
+    }
+    for (int k = 0; k < shmstate::FIELDS; k++)
+        for (uint32_t i = 0; i < count; i++)
+            if (fields[k][i] != valueFor(frame, k, i)) {
+                why = "field " + std::to_string(k) + " index " + std::to_string(i);
+                return false;
+            }
+    return true;
+}
+
+static int runReader(int id, const char* name, int frames, uint32_t capacity) {
+    StateReader reader;
+    if (!reader.open(name)) return 1;
+    if (reader.x0() != WALLS[0] || reader.y0() != WALLS[1] || reader.x1() != WALLS[2] || reader.y1() != WALLS[3]) {
+        fprintf(stderr, "reader %d: domain %g %g %g %g, expected %g %g %g %g\n", id,
+                reader.x0(), reader.y0(), reader.x1(), reader.y1(), WALLS[0], WALLS[1], WALLS[2], WALLS[3]);
+        return 1;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point deadline = Clock::now() + std::chrono::seconds(TIMEOUT_SECONDS);
+    const uint64_t last = (uint64_t)frames - 1;
+    ReaderStats stats;
+    uint64_t newest = 0;
+    bool any = false;
+    StateSnapshot snap;
+
+    for (int attempt = 0; !(any && newest == last); attempt++) {
+        if (Clock::now() > deadline) {
+            fprintf(stderr, "reader %d: timed out at frame %llu of %llu\n", id,
+                    (unsigned long long)newest, (unsigned long long)last);
+            return 1;
+        }
+
+        uint64_t frame;
+        std::string why;
+        bool ok;
+        if (attempt % 2 == 0) {
+            StateFrame f;
+            if (!reader.acquire(f)) { stats.busy++; continue; }
+            const float* fields[] = { f.posX, f.posY, f.velX, f.velY, f.density };
+            ok = payloadMatches(f.frame, f.count, capacity, fields, why);
+            if (!reader.valid(f)) { stats.torn++; continue; }
+
+            frame = f.frame;
+            uint64_t expectSeq = 2 * (frame / shmstate::SLOTS + 1);
+            if (ok && f.seq != expectSeq) {
+                why = "slot sequence " + std::to_string(f.seq) + ", expected " + std::to_string(expectSeq);
+                ok = false;
+            }
+        } else {
+            if (!reader.snapshot(snap)) { stats.busy++; continue; }
+            const float* fields[] = { snap.posX.data(), snap.posY.data(), snap.velX.data(),
+                                      snap.velY.data(), snap.density.data() };
+            frame = snap.frame;
+            ok = payloadMatches(frame, (uint32_t)snap.posX.size(), capacity, fields, why);
+        }
+
+        if (!ok) {
+            fprintf(stderr, "reader %d: accepted a torn frame %llu (%s)\n", id, (unsigned long long)frame, why.c_str());
+            return 1;
+        }
+        if (any && frame < newest) {
+            fprintf(stderr, "reader %d: frame %llu after frame %llu\n", id,
+                    (unsigned long long)frame, (unsigned long long)newest);
+            return 1;
+        }
+        if (reader.published() < frame + 1) {
+            fprintf(stderr, "reader %d: frame %llu but only %llu published\n", id,
+                    (unsigned long long)frame, (unsigned long long)reader.published());
+            return 1;
+        }
+        if (frame > newest || !any) {
+            stats.skipped += any ? frame - newest - 1 : frame;
+            stats.accepted++;
+        }
+        newest = frame;
+        any = true;
+    }
+
+    printf("reader %d: %llu frames checked, %llu skipped by the ring, %llu torn reads caught, %llu busy\n", id,
+           (unsigned long long)stats.accepted, (unsigned long long)stats.skipped,
+           (unsigned long long)stats.torn, (unsigned long long)stats.busy);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int readers       = argc > 1 ? atoi(argv[1]) : 4;
+    int frames        = argc > 2 ? atoi(argv[2]) : 2000;
+    uint32_t capacity = argc > 3 ? (uint32_t)atoi(argv[3]) : 20000;
+    if (readers < 1 || frames < 1 || capacity < 97) {
+        fprintf(stderr, "usage: StateExportTest [readers >= 1] [frames >= 1] [particles >= 97]\n");
+        return 2;
+    }
+
+    std::string name = "/liquidsim-test-" + std::to_string((long)getpid());
+    fflush(stdout);
+
+    int pipeFd[2];
+    if (pipe(pipeFd) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    pid_t writer = fork();
+    if (writer < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (writer == 0) {
+        close(pipeFd[0]);
+        _exit(runWriter(name.c_str(), frames, capacity, pipeFd[1]));
+    }
+
+    // Readers start once the segment exists
+    close(pipeFd[1]);
+    char ready;
+    bool started = read(pipeFd[0], &ready, 1) == 1;
+    close(pipeFd[0]);
+
+    std::vector<pid_t> children;
+    for (int r = 0; started && r < readers; r++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            break;
+        }
+        if (pid == 0) {
+            int result = runReader(r, name.c_str(), frames, capacity);
+            fflush(stdout);
+            _exit(result);
+        }
+        children.push_back(pid);
+    }
+
+    int failed = started && (int)children.size() == readers ? 0 : 1;
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+    }
+    int status = 0;
+    waitpid(writer, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+
+    printf("%s: %d readers, %d frames of up to %u particles\n", failed ? "FAILED" : "passed",
+           readers, frames, capacity);
+    return failed ? 1 : 0;
+}